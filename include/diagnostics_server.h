@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * Local diagnostics endpoint
+ *
+ * A small esp_http_server instance plus an mDNS responder, meant to run
+ * only while the device is on USB power and keeps WiFi up anyway. The
+ * server runs in its own task, so scrapes never block loop() or the
+ * network task. Routes are plain functions that write their response
+ * with diagPrintf(); output goes out as HTTP chunks through a fixed
+ * buffer, so a scrape costs no heap beyond the server's own sockets.
+ */
+
+#include <Arduino.h>
+
+#define DIAGNOSTICS_PORT         80
+#define DIAGNOSTICS_CHUNK_SIZE   512   // Response buffer, on the server task's stack
+#define DIAGNOSTICS_TASK_STACK   4096
+#define DIAGNOSTICS_MAX_SOCKETS  3
+#define DIAGNOSTICS_HOSTNAME_LEN 32
+
+struct DiagnosticsOutput;
+typedef void (*DiagnosticsWriter)(DiagnosticsOutput& out);
+
+struct DiagnosticsRoute {
+  const char* uri;
+  const char* contentType;
+  DiagnosticsWriter write;
+};
+
+/**
+ * Start the server and announce it as <hostname>.local (_http._tcp).
+ * routes must outlive the server. No-op if it is already running.
+ */
+bool diagnosticsStart(const char* hostname, const DiagnosticsRoute* routes, size_t routeCount);
+void diagnosticsStop();
+bool diagnosticsRunning();
+
+// Append formatted text to the response; longer than one chunk is truncated
+void diagPrintf(DiagnosticsOutput& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
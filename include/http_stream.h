@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+ * Streaming HTTP response body
+ *
+ * Stream adapter over a connected Client that parses the response head
+ * and then removes chunked framing on the fly, or stops after exactly
+ * Content-Length bytes, so the end of the body never waits on a timeout.
+ * Socket data is pulled with bulk client.read(buf, n) into one small
+ * buffer and decoded in place, so ArduinoJson can parse straight from the
+ * connection without the response ever being copied whole. Waiting for
+ * the server is a select() on the socket (TlsSessionClient::waitReadable),
+ * never a polling loop.
+ */
+
+#include <Arduino.h>
+#include "tls_session_client.h"
+#include "chunked_decoder.h"
+#include "http_response.h"
+
+#define HTTP_STREAM_BUFFER_SIZE 128
+#define HTTP_STREAM_TIMEOUT_MS  5000
+#define HTTP_HEADER_LINE_MAX    160   // Longer header lines are skipped
+
+class HttpBodyStream : public Stream {
+public:
+  HttpBodyStream(TlsSessionClient& client, unsigned long timeoutMs = HTTP_STREAM_TIMEOUT_MS);
+
+  // Parse the status line and headers; the stream then yields the body
+  bool readHead(HttpResponseHead& head);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char* buffer, size_t length) override;
+  size_t write(uint8_t) override { return 0; }
+  void flush() override {}
+
+  // True once the body ended cleanly (last chunk, Content-Length reached or connection closed)
+  bool finished() const { return _finished; }
+  bool failed() const { return _decoder.failed(); }
+
+private:
+  bool refill();
+
+  TlsSessionClient& _client;
+  bool _chunked;
+  unsigned long _timeoutMs;
+  bool _finished;
+  int32_t _remaining;     // Unread Content-Length bytes, -1 = unknown
+  ChunkedDecoder _decoder;
+  uint8_t _buf[HTTP_STREAM_BUFFER_SIZE];
+  size_t _pos;
+  size_t _len;
+};
+
+// Scanning helpers for JSON bodies read off a Stream
+
+// Skip JSON whitespace; returns the next byte without consuming it (-1 at the end)
+int skipJsonSpace(Stream& stream);
+
+// Advance past `"key"`, optional whitespace and the colon, then any
+// whitespace before the value; false if the key never appears
+bool findJsonKey(Stream& stream, const char* key);
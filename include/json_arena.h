@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * Bounded arena allocator for ArduinoJson documents
+ *
+ * A fixed buffer handed to JsonDocument in place of the heap, so a large
+ * or hostile payload fails with NoMemory instead of growing and
+ * fragmenting the heap that mbedTLS needs. Blocks are bump-allocated; the
+ * arena rewinds when the last live block is freed (doc.clear()).
+ */
+
+#include <ArduinoJson.h>
+#include <string.h>
+
+// Arena sizes for the streamed documents, checked against captured
+// payloads by test/test_json. ArduinoJson 7 allocates a whole slot pool
+// (ARDUINOJSON_POOL_CAPACITY slots, set in platformio.ini) before the
+// first value, then copies it down to size once parsing ends; the arena
+// has to hold the pool, its shrunk copy and the kept strings.
+#define PRICE_STREAM_JSON_ARENA_SIZE 2048  // One filtered ticker message
+#define HISTORY_JSON_ARENA_SIZE      1536  // One [timestamp, price] pair at a time
+
+template <size_t N>
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    size_t need = HEADER + align(size);
+    if (_used + need > N) return nullptr;
+
+    uint8_t* block = _buf + _used;
+    memcpy(block, &size, sizeof(size));
+    _top = _used;
+    _used += need;
+    _live++;
+    if (_used > _peak) _peak = _used;
+    return block + HEADER;
+  }
+
+  void deallocate(void* ptr) override {
+    if (!ptr) return;
+    if (offsetOf(ptr) == _top) {
+      _used = _top;  // Freeing the newest block gives its space back
+      _top = NO_TOP;
+    }
+    if (--_live == 0) {
+      _used = 0;
+      _top = NO_TOP;
+    }
+  }
+
+  void* reallocate(void* ptr, size_t newSize) override {
+    if (!ptr) return allocate(newSize);
+
+    size_t offset = offsetOf(ptr);
+    if (offset == _top) {
+      // Newest block grows or shrinks in place
+      if (_top + HEADER + align(newSize) > N) return nullptr;
+      memcpy(_buf + _top, &newSize, sizeof(newSize));
+      _used = _top + HEADER + align(newSize);
+      if (_used > _peak) _peak = _used;
+      return ptr;
+    }
+
+    size_t oldSize;
+    memcpy(&oldSize, _buf + offset, sizeof(oldSize));
+    void* moved = allocate(newSize);
+    if (!moved) return nullptr;
+    memcpy(moved, ptr, oldSize < newSize ? oldSize : newSize);
+    deallocate(ptr);
+    return moved;
+  }
+
+  size_t used() const { return _used; }
+  size_t peak() const { return _peak; }
+  size_t capacity() const { return N; }
+
+private:
+  static const size_t ALIGN = 8;
+  static const size_t HEADER = ALIGN;  // Block size, padded to keep payloads aligned
+  static const size_t NO_TOP = (size_t)-1;
+
+  static size_t align(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+  size_t offsetOf(void* ptr) const { return (uint8_t*)ptr - HEADER - _buf; }
+
+  alignas(ALIGN) uint8_t _buf[N];
+  size_t _used = 0;
+  size_t _top = NO_TOP;
+  size_t _peak = 0;
+  size_t _live = 0;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+/**
+ * TLS client with per-host session resumption
+ *
+ * Drop-in replacement for WiFiClientSecure that offers the last session
+ * ticket for the host on connect, so repeat connections do an abbreviated
+ * handshake instead of the full certificate exchange. Sessions are
+ * serialized into NVS so they survive deep sleep and reboots.
+ *
+ * waitReadable() blocks in select() on the socket instead of polling
+ * available(), so the core idles while the server thinks. The time from
+ * the last request write to the first byte that read() or available()
+ * sees is recorded per host.
+ */
+
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+
+#define TLS_SESSION_MAX_SIZE   2560   // Serialized session incl. peer certificate
+#define TLS_CONNECT_TIMEOUT_MS 15000
+#define TLS_STATS_SLOTS        8      // Price sources, ticker feed, GitHub API/web, release CDN
+#define TLS_STATS_HOST_LEN     48
+#define TLS_RESUMED_MAX_BYTES  1024   // A full handshake receives the certificate chain
+#define TLS_HISTOGRAM_BUCKETS  8      // Upper bounds below, plus one overflow bucket
+
+// Bucket upper bounds (ms) for the handshake and time-to-first-byte histograms
+extern const uint16_t TLS_HISTOGRAM_BOUNDS_MS[TLS_HISTOGRAM_BUCKETS - 1];
+
+// Handshake counters per host, to measure what resumption saves
+struct TlsHandshakeStats {
+  char host[TLS_STATS_HOST_LEN];
+  uint32_t fullCount;
+  uint32_t resumedCount;
+  uint32_t failedCount;
+  uint32_t fullTotalMs;
+  uint32_t resumedTotalMs;
+  uint32_t lastMs;
+  bool lastResumed;
+  uint32_t ttfbCount;       // Requests that got a first response byte
+  uint32_t ttfbTotalMs;
+  uint32_t lastTtfbMs;
+  uint32_t handshakeBuckets[TLS_HISTOGRAM_BUCKETS];  // Successful handshakes, full or resumed
+  uint32_t ttfbBuckets[TLS_HISTOGRAM_BUCKETS];
+};
+
+class TlsSessionClient : public WiFiClientSecure {
+public:
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  int connect(const char* host, uint16_t port, int32_t timeout);
+
+  size_t write(const uint8_t* buf, size_t size) override;
+  using WiFiClientSecure::write;
+
+  // Write that is not a request (e.g. a WebSocket PONG): does not start a TTFB sample
+  size_t writeUntimed(const uint8_t* buf, size_t size) { return WiFiClientSecure::write(buf, size); }
+
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+
+  /**
+   * Block until decrypted data is available, the peer closes or the
+   * timeout passes. True if data can be read.
+   */
+  bool waitReadable(int32_t timeoutMs);
+
+  bool lastHandshakeResumed() const { return _resumed; }
+  uint32_t lastTimeToFirstByte() const { return _lastTtfbMs; }  // 0 until the current request's first byte
+
+private:
+  int openTls(const IPAddress& ip, uint16_t port, const char* host, int32_t timeoutMs);
+  bool restoreSession(const char* host);
+  void saveSession(const char* host);
+
+  void noteFirstByte();
+
+  static int handshakeSend(void* ctx, const unsigned char* buf, size_t len);
+  static int handshakeRecv(void* ctx, unsigned char* buf, size_t len);
+
+  size_t _handshakeRxBytes = 0;
+  bool _resumed = false;
+  bool _sessionOffered = false;      // restoreSession() loaded a stored session...
+  uint32_t _offeredFingerprint = 0;  // ...with this ID/ticket fingerprint
+  TlsHandshakeStats* _stats = NULL;
+  unsigned long _requestSentMs = 0;
+  bool _awaitingFirstByte = false;
+  uint32_t _lastTtfbMs = 0;
+};
+
+size_t tlsStatsCount();
+const TlsHandshakeStats* tlsStats(size_t index);
+void printTlsStats();
+void forgetTlsSessions();
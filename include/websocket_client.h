@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * WebSocket client over a TlsSessionClient
+ *
+ * Performs the HTTP/1.1 upgrade (checking Sec-WebSocket-Accept), then
+ * reads frames through a WebSocketDecoder into a caller-supplied fixed
+ * buffer. poll() waits in select() like the HTTP paths, answers pings
+ * itself and hands back one data message at a time; nothing is
+ * allocated per frame.
+ */
+
+#include <Arduino.h>
+#include "tls_session_client.h"
+#include "websocket_frame.h"
+#include "http_response.h"
+
+#define WS_RX_BUFFER_SIZE       128
+#define WS_TX_BUFFER_SIZE       256    // Largest frame sent (subscribe request)
+#define WS_HANDSHAKE_TIMEOUT_MS 10000
+#define WS_HEADER_LINE_MAX      160    // Longer header lines are skipped
+
+enum WebSocketPoll {
+  WS_POLL_MESSAGE,   // message() holds a complete data message
+  WS_POLL_TIMEOUT,   // Nothing within the timeout; the connection is still up
+  WS_POLL_CLOSED     // Peer closed, protocol error or socket failure
+};
+
+class WebSocketClient {
+public:
+  WebSocketClient(TlsSessionClient& client, uint8_t* messageBuffer, size_t capacity);
+
+  // TLS connect to host:443 and upgrade on `path`; the client is stopped on failure
+  bool connect(const char* host, const char* path);
+  bool sendText(const char* text);
+
+  WebSocketPoll poll(int32_t timeoutMs);
+  const char* message() const { return (const char*)_decoder.message(); }
+  size_t messageLength() const { return _decoder.messageLength(); }
+
+  // Send a close frame (best effort) and drop the connection
+  void close();
+
+private:
+  bool upgrade(const char* host, const char* path);
+  bool readHead(HttpResponseHead& head);
+  bool sendFrame(uint8_t opcode, const uint8_t* payload, size_t len);
+
+  TlsSessionClient& _client;
+  WebSocketDecoder _decoder;
+  uint8_t _rx[WS_RX_BUFFER_SIZE];
+  size_t _rxPos;
+  size_t _rxLen;
+};
@@ -0,0 +1,17 @@
+#include "backoff.h"
+
+int32_t backoffDelayMs(int attempt, int32_t initialMs, int32_t maxMs, uint32_t entropy) {
+  if (attempt <= 0) return 0;
+
+  // Exponential: 5s, 10s, 20s... (doubling stops once the cap is reached)
+  int32_t backoff = initialMs;
+  for (int i = 1; i < attempt && backoff < maxMs; i++) {
+    backoff = (backoff > maxMs / 2) ? maxMs : backoff * 2;
+  }
+  if (backoff > maxMs) backoff = maxMs;
+
+  // Add jitter (±20%), uniform in [-span, span)
+  int32_t span = backoff / 5;
+  if (span == 0) return backoff;
+  return backoff - span + (int32_t)(entropy % (uint32_t)(2 * span));
+}
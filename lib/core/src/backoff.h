@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * Exponential retry backoff with jitter
+ *
+ * The random source is injected so the schedule can be tested on the
+ * host: pass esp_random() on the device, a fixed value in tests.
+ */
+
+#include <stdint.h>
+
+/**
+ * initialMs doubled per attempt after the first, capped at maxMs, then
+ * spread by +-20% using `entropy`. 0 for attempt <= 0.
+ */
+int32_t backoffDelayMs(int attempt, int32_t initialMs, int32_t maxMs, uint32_t entropy);
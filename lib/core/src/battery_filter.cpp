@@ -0,0 +1,51 @@
+#include "battery_filter.h"
+
+void batteryFilterReset(BatteryFilter& f) {
+  f.emaMv16 = 0;
+  f.reportedMv = 0;
+  f.level = BATTERY_ABSENT;
+  f.charging = false;
+  f.primed = false;
+}
+
+uint16_t batteryFilterMv(const BatteryFilter& f) {
+  return (uint16_t)((f.emaMv16 + 8) >> 4);
+}
+
+static uint8_t classify(uint8_t previous, uint16_t mv, const BatteryThresholds& t) {
+  if (mv < t.absentMv) return BATTERY_ABSENT;
+  if (mv < t.criticalMv) return BATTERY_CRITICAL;
+  if (mv < t.lowMv) return BATTERY_LOW;
+  if (previous == BATTERY_LOW && mv < t.lowClearMv) return BATTERY_LOW;
+  return BATTERY_OK;
+}
+
+bool batteryFilterUpdate(BatteryFilter& f, uint16_t sampleMv, const BatteryThresholds& t) {
+  if (sampleMv > t.invalidMv) {
+    bool changed = !f.charging;
+    f.charging = true;
+    return changed;
+  }
+
+  uint32_t sample16 = (uint32_t)sampleMv << 4;
+  if (!f.primed) {
+    f.emaMv16 = sample16;
+    f.primed = true;
+  } else if (sample16 >= f.emaMv16) {
+    f.emaMv16 += (sample16 - f.emaMv16) >> BATTERY_EMA_SHIFT;
+  } else {
+    f.emaMv16 -= (f.emaMv16 - sample16) >> BATTERY_EMA_SHIFT;
+  }
+
+  uint16_t mv = batteryFilterMv(f);
+  uint8_t level = classify(f.level, mv, t);
+  bool charging = f.charging ? (mv >= t.chargingClearMv) : (mv > t.chargingMv);
+
+  uint16_t delta = (mv > f.reportedMv) ? mv - f.reportedMv : f.reportedMv - mv;
+  bool changed = level != f.level || charging != f.charging || delta >= BATTERY_REPORT_STEP_MV;
+
+  f.level = level;
+  f.charging = charging;
+  if (changed) f.reportedMv = mv;
+  return changed;
+}
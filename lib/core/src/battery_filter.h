@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * Battery voltage filter with hysteresis
+ *
+ * Oversampled, calibrated readings (millivolts at the battery, after the
+ * divider) are smoothed with an EMA, and the LOW and CHARGING states only
+ * change once the filtered voltage crosses a threshold plus a margin, so
+ * ADC noise around 3.5 V or 4.3 V no longer flickers the status corner.
+ * Plain aggregate so the filter can be RTC_DATA_ATTR and keep its state
+ * across deep sleep.
+ */
+
+#include <stdint.h>
+
+#define BATTERY_EMA_SHIFT       3    // EMA weight 1/8 per sample
+#define BATTERY_REPORT_STEP_MV  10   // Smallest change worth redrawing (two decimals)
+
+enum BatteryLevel : uint8_t {
+  BATTERY_ABSENT,    // Reading near 0 V: no battery on the divider
+  BATTERY_OK,
+  BATTERY_LOW,
+  BATTERY_CRITICAL
+};
+
+struct BatteryThresholds {
+  uint16_t absentMv;        // Below: no battery connected
+  uint16_t criticalMv;      // Below: shut down
+  uint16_t lowMv;           // Below: LOW...
+  uint16_t lowClearMv;      // ...until back above this
+  uint16_t chargingMv;      // Above: plugged in...
+  uint16_t chargingClearMv; // ...until back below this
+  uint16_t invalidMv;       // Above: the divider sees the USB rail, not the cell
+};
+
+struct BatteryFilter {
+  uint32_t emaMv16;         // Filtered voltage, mV << 4
+  uint16_t reportedMv;      // Voltage when the last change was reported
+  uint8_t level;            // BatteryLevel
+  bool charging;
+  bool primed;              // False until the first valid sample
+};
+
+void batteryFilterReset(BatteryFilter& f);
+
+/**
+ * Feed one sample. Returns true when the level, the charging state or
+ * the filtered voltage (by BATTERY_REPORT_STEP_MV) changed since the
+ * last report. A sample above invalidMv means external power: it sets
+ * the charging state but is kept out of the filtered voltage.
+ */
+bool batteryFilterUpdate(BatteryFilter& f, uint16_t sampleMv, const BatteryThresholds& t);
+
+uint16_t batteryFilterMv(const BatteryFilter& f);
@@ -0,0 +1,129 @@
+#include "chunked_decoder.h"
+
+#include <string.h>
+
+#define CHUNK_SIZE_MAX_DIGITS 7  // Anything above 256 MB is a framing error here
+
+static int hexValue(uint8_t c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+void ChunkedDecoder::reset() {
+  state = SIZE;
+  remaining = 0;
+  sizeDigits = 0;
+}
+
+void ChunkedDecoder::endSizeLine() {
+  if (sizeDigits == 0) {
+    state = FAILED;
+  } else if (remaining == 0) {
+    state = TRAILER;  // Last chunk
+  } else {
+    state = DATA;
+  }
+  sizeDigits = 0;
+}
+
+size_t ChunkedDecoder::decode(uint8_t* buf, size_t len) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < len && state != DONE && state != FAILED) {
+    uint8_t c = buf[in];
+
+    switch (state) {
+      case SIZE: {
+        int v = hexValue(c);
+        if (v >= 0) {
+          if (++sizeDigits > CHUNK_SIZE_MAX_DIGITS) {
+            state = FAILED;
+            break;
+          }
+          remaining = (remaining << 4) | (uint32_t)v;
+        } else if (c == '\r') {
+          state = SIZE_LF;
+        } else if (c == '\n') {
+          endSizeLine();
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          state = SIZE_EXT;
+        } else {
+          state = FAILED;
+        }
+        in++;
+        break;
+      }
+
+      case SIZE_EXT:
+        if (c == '\n') endSizeLine();
+        in++;
+        break;
+
+      case SIZE_LF:
+        if (c == '\n') {
+          endSizeLine();
+        } else {
+          state = FAILED;
+        }
+        in++;
+        break;
+
+      case DATA: {
+        size_t n = len - in;
+        if (n > remaining) n = remaining;
+        if (out != in) memmove(buf + out, buf + in, n);
+        out += n;
+        in += n;
+        remaining -= n;
+        if (remaining == 0) state = DATA_CR;
+        break;
+      }
+
+      case DATA_CR:
+        if (c == '\r') {
+          state = DATA_LF;
+        } else if (c == '\n') {
+          state = SIZE;
+        } else {
+          state = FAILED;
+        }
+        in++;
+        break;
+
+      case DATA_LF:
+        state = (c == '\n') ? SIZE : FAILED;
+        in++;
+        break;
+
+      case TRAILER:
+        if (c == '\r') {
+          state = TRAILER_LF;
+        } else if (c == '\n') {
+          state = DONE;
+        } else {
+          state = TRAILER_LINE;
+        }
+        in++;
+        break;
+
+      case TRAILER_LINE:
+        if (c == '\n') state = TRAILER;
+        in++;
+        break;
+
+      case TRAILER_LF:
+        state = (c == '\n') ? DONE : FAILED;
+        in++;
+        break;
+
+      default:
+        in++;
+        break;
+    }
+  }
+
+  return out;
+}
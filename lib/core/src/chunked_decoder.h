@@ -0,0 +1,49 @@
+#pragma once
+
+/**
+ * Incremental HTTP/1.1 chunked transfer-encoding decoder
+ *
+ * Hardware-independent state machine: feed it raw socket bytes in any
+ * split and it strips the chunk framing in place, so a single receive
+ * buffer serves both the socket read and the parser.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+class ChunkedDecoder {
+public:
+  ChunkedDecoder() { reset(); }
+
+  void reset();
+
+  /**
+   * Decode `len` raw bytes at `buf` in place.
+   * Body bytes are compacted to the front of `buf`; returns their count.
+   */
+  size_t decode(uint8_t* buf, size_t len);
+
+  bool finished() const { return state == DONE; }
+  bool failed() const { return state == FAILED; }
+
+private:
+  enum State {
+    SIZE,          // Hex chunk size
+    SIZE_EXT,      // ";ext" or whitespace after the size, up to LF
+    SIZE_LF,       // LF after CR ending the size line
+    DATA,          // Chunk payload
+    DATA_CR,       // CR after the payload
+    DATA_LF,       // LF after the payload
+    TRAILER,       // Start of a trailer line (or the final empty line)
+    TRAILER_LINE,  // Skipping a trailer header
+    TRAILER_LF,    // LF ending the final empty line
+    DONE,
+    FAILED
+  };
+
+  void endSizeLine();
+
+  State state;
+  uint32_t remaining;
+  uint8_t sizeDigits;
+};
@@ -0,0 +1,99 @@
+#include "energy_log.h"
+
+#include <string.h>
+
+static const char* const PHASE_NAMES[PHASE_COUNT] = {
+  "wifi", "tls", "http", "parse", "draw", "session"
+};
+
+const char* energyPhaseName(uint8_t phase) {
+  return phase < PHASE_COUNT ? PHASE_NAMES[phase] : "?";
+}
+
+void phaseReset(PhaseTimer& t) {
+  memset(&t, 0, sizeof(t));
+}
+
+void phaseBegin(PhaseTimer& t, uint8_t phase, uint64_t nowUs) {
+  if (phase >= PHASE_COUNT) return;
+  t.startUs[phase] = nowUs;
+  t.running |= 1u << phase;
+}
+
+void phaseEnd(PhaseTimer& t, uint8_t phase, uint64_t nowUs) {
+  if (phase >= PHASE_COUNT || !(t.running & (1u << phase))) return;
+  t.totalUs[phase] += nowUs - t.startUs[phase];
+  t.running &= ~(1u << phase);
+}
+
+static uint64_t subtractFloor(uint64_t a, uint64_t b) {
+  return a > b ? a - b : 0;
+}
+
+void energyClose(WakeEnergy& record, const PhaseTimer& network, const PhaseTimer& ui,
+                 const EnergyModel& model, uint32_t uptimeS, uint32_t windowMs,
+                 uint32_t sleepMs, uint16_t batteryMv) {
+  record.uptimeS = uptimeS;
+  record.windowMs = windowMs;
+  record.sleepMs = sleepMs < windowMs ? sleepMs : windowMs;
+  record.batteryMv = batteryMv;
+  uint64_t phaseUs[PHASE_COUNT];
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    phaseUs[p] = network.totalUs[p] + ui.totalUs[p];
+    uint64_t ms = phaseUs[p] / 1000;
+    record.phaseMs[p] = ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+  }
+
+  // mA x µs = nC; µA x ms = nC
+  uint64_t nc = 0;
+  uint64_t radioBusyUs = 0;
+  for (uint8_t p = PHASE_WIFI; p <= PHASE_PARSE; p++) {
+    nc += phaseUs[p] * model.phaseMa[p];
+    radioBusyUs += phaseUs[p];
+  }
+  uint64_t sessionUs = phaseUs[PHASE_SESSION];
+  nc += subtractFloor(sessionUs, radioBusyUs) * model.phaseMa[PHASE_SESSION];
+  nc += phaseUs[PHASE_DRAW] * model.phaseMa[PHASE_DRAW];
+
+  uint64_t awakeUs = (uint64_t)(windowMs - record.sleepMs) * 1000;
+  uint64_t otherAwakeUs = subtractFloor(awakeUs, sessionUs + phaseUs[PHASE_DRAW]);
+  nc += otherAwakeUs * model.awakeMa;
+  nc += (uint64_t)record.sleepMs * model.sleepUa;
+
+  uint64_t uc = nc / 1000;
+  record.chargeUc = uc > UINT32_MAX ? UINT32_MAX : (uint32_t)uc;
+}
+
+uint32_t energyMicroAmpHours(const WakeEnergy& record) {
+  return (uint32_t)(((uint64_t)record.chargeUc + 1800) / 3600);  // 1 µAh = 3.6 mC
+}
+
+uint32_t energyMillijoules(const WakeEnergy& record) {
+  return (uint32_t)((uint64_t)record.chargeUc * record.batteryMv / 1000000);
+}
+
+void energyLogReset(EnergyLog& log) {
+  memset(&log, 0, sizeof(log));
+}
+
+void energyLogPush(EnergyLog& log, const WakeEnergy& record) {
+  log.records[log.head] = record;
+  log.head = (log.head + 1) % ENERGY_LOG_CAPACITY;
+  if (log.count < ENERGY_LOG_CAPACITY) log.count++;
+}
+
+const WakeEnergy& energyLogAt(const EnergyLog& log, size_t i) {
+  size_t oldest = (log.head + ENERGY_LOG_CAPACITY - log.count) % ENERGY_LOG_CAPACITY;
+  return log.records[(oldest + i) % ENERGY_LOG_CAPACITY];
+}
+
+uint32_t energyLogMicroAmpHoursPerHour(const EnergyLog& log) {
+  uint64_t uc = 0, ms = 0;
+  for (size_t i = 0; i < log.count; i++) {
+    uc += energyLogAt(log, i).chargeUc;
+    ms += energyLogAt(log, i).windowMs;
+  }
+  if (ms == 0) return 0;
+  // Average current: µC / ms = mA, and µAh per hour is the current in µA
+  return (uint32_t)(uc * 1000 / ms);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * Per-phase timing and estimated charge per wake
+ *
+ * A PhaseTimer accumulates microseconds spent in each instrumented phase
+ * (WiFi association, TLS handshake, HTTP request/head, body parse, draw,
+ * and the whole radio-on session). When a wake closes, the phase times
+ * and the awake/sleep split are weighted with an EnergyModel of estimated
+ * current per state into a WakeEnergy record, kept in a small ring so the
+ * last few wakes can be compared. Plain aggregates so the ring can be
+ * RTC_DATA_ATTR; timestamps are passed in so this builds on the host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ENERGY_LOG_CAPACITY 16
+
+enum EnergyPhase : uint8_t {
+  PHASE_WIFI,      // Association + DHCP
+  PHASE_TLS,       // TLS connect (full or resumed handshake)
+  PHASE_HTTP,      // Request write until the response head is parsed
+  PHASE_PARSE,     // Streaming body read + JSON parse
+  PHASE_DRAW,      // Composing and pushing the frame buffer
+  PHASE_SESSION,   // Whole network job, radio on
+  PHASE_COUNT
+};
+
+const char* energyPhaseName(uint8_t phase);
+
+struct PhaseTimer {
+  uint64_t startUs[PHASE_COUNT];
+  uint64_t totalUs[PHASE_COUNT];  // 32 bits would wrap after 71 minutes of streaming
+  uint8_t running;   // Bit per phase
+};
+
+void phaseReset(PhaseTimer& t);
+void phaseBegin(PhaseTimer& t, uint8_t phase, uint64_t nowUs);
+void phaseEnd(PhaseTimer& t, uint8_t phase, uint64_t nowUs);  // No-op if not running
+
+// Estimated current per state; PHASE_SESSION is the radio-on time not in another phase
+struct EnergyModel {
+  uint16_t phaseMa[PHASE_COUNT];
+  uint16_t awakeMa;     // CPU on, radio off, outside the draw phase
+  uint16_t sleepUa;     // Light/deep sleep (backlight and panel included)
+};
+
+struct WakeEnergy {
+  uint32_t uptimeS;              // When the record was closed
+  uint32_t windowMs;             // Time since the previous record
+  uint32_t sleepMs;              // Part of the window spent asleep
+  uint32_t phaseMs[PHASE_COUNT];
+  uint16_t batteryMv;
+  uint32_t chargeUc;             // Estimated charge drawn over the window (µC)
+};
+
+/**
+ * Fill `record` from the accumulated phases and the window split, and
+ * compute its charge from the model.
+ */
+void energyClose(WakeEnergy& record, const PhaseTimer& network, const PhaseTimer& ui,
+                 const EnergyModel& model, uint32_t uptimeS, uint32_t windowMs,
+                 uint32_t sleepMs, uint16_t batteryMv);
+
+// Charge in µAh and energy in mJ at the recorded battery voltage
+uint32_t energyMicroAmpHours(const WakeEnergy& record);
+uint32_t energyMillijoules(const WakeEnergy& record);
+
+struct EnergyLog {
+  uint16_t head;
+  uint16_t count;
+  WakeEnergy records[ENERGY_LOG_CAPACITY];
+};
+
+void energyLogReset(EnergyLog& log);
+void energyLogPush(EnergyLog& log, const WakeEnergy& record);
+const WakeEnergy& energyLogAt(const EnergyLog& log, size_t i);  // i = 0 is the oldest
+
+// Average drain over the logged windows, in µAh per hour (0 while empty)
+uint32_t energyLogMicroAmpHoursPerHour(const EnergyLog& log);
@@ -0,0 +1,73 @@
+#include "firmware_image.h"
+
+#include <string.h>
+
+#define IMAGE_HEADER_LEN         24
+#define IMAGE_HASH_APPENDED_AT   23   // esp_image_header_t::hash_appended
+#define SEGMENT_HEADER_LEN       8    // load_addr, data_len
+
+static uint32_t readLe32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool firmwareImageLength(ImageReader read, void* ctx, uint32_t partitionSize, uint32_t& length) {
+  uint8_t header[IMAGE_HEADER_LEN];
+  if (partitionSize < IMAGE_HEADER_LEN || !read(ctx, 0, header, sizeof(header))) return false;
+
+  uint8_t segments = header[1];
+  if (header[0] != FIRMWARE_IMAGE_MAGIC || segments == 0 || segments > FIRMWARE_IMAGE_MAX_SEGMENTS) {
+    return false;
+  }
+
+  uint32_t offset = IMAGE_HEADER_LEN;
+  for (uint8_t i = 0; i < segments; i++) {
+    uint8_t segment[SEGMENT_HEADER_LEN];
+    if (offset > partitionSize - SEGMENT_HEADER_LEN || !read(ctx, offset, segment, sizeof(segment))) {
+      return false;
+    }
+    uint32_t dataLen = readLe32(segment + 4);
+    offset += SEGMENT_HEADER_LEN;
+    if (dataLen > partitionSize - offset) return false;
+    offset += dataLen;
+  }
+
+  // Checksum byte, then padding to a 16-byte boundary
+  uint32_t end = (offset + 1 + 15) & ~15u;
+  if (header[IMAGE_HASH_APPENDED_AT] == 1) end += SHA256_DIGEST_LEN;
+  if (end > partitionSize) return false;
+
+  length = end;
+  return true;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool parseSha256Hex(const char* text, uint8_t digest[SHA256_DIGEST_LEN]) {
+  while (*text == ' ' || *text == '\t') text++;
+  if (strncmp(text, "sha256:", 7) == 0) text += 7;
+
+  for (size_t i = 0; i < SHA256_DIGEST_LEN; i++) {
+    int hi = hexValue(text[2 * i]);
+    int lo = (hi < 0) ? -1 : hexValue(text[2 * i + 1]);
+    if (lo < 0) return false;
+    digest[i] = (uint8_t)(hi << 4 | lo);
+  }
+
+  // Exactly 64 digits: what follows must not extend the hex run
+  char next = text[SHA256_HEX_LEN];
+  return next == '\0' || next == ' ' || next == '\t' || next == '\r' || next == '\n' || next == '*';
+}
+
+void formatSha256Hex(const uint8_t digest[SHA256_DIGEST_LEN], char* out) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < SHA256_DIGEST_LEN; i++) {
+    out[2 * i] = digits[digest[i] >> 4];
+    out[2 * i + 1] = digits[digest[i] & 0x0F];
+  }
+  out[SHA256_HEX_LEN] = '\0';
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+/**
+ * ESP32 app image layout and published SHA-256 digests
+ *
+ * firmwareImageLength() walks the image header and segment table of an
+ * app in flash to find how many bytes the original .bin file had: the
+ * segments, the checksum byte padded to 16 bytes, and the appended
+ * SHA-256 if the header says so. Hashing that many bytes of a partition
+ * gives the same digest as hashing the released file, so a running or
+ * staged image can be compared with a published digest without a
+ * download. Flash access goes through a callback so this builds on the
+ * host.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FIRMWARE_IMAGE_MAGIC        0xE9
+#define FIRMWARE_IMAGE_MAX_SEGMENTS 16
+#define SHA256_DIGEST_LEN           32
+#define SHA256_HEX_LEN              64
+
+// Read `len` bytes at `offset`; false on a flash error
+typedef bool (*ImageReader)(void* ctx, uint32_t offset, void* buf, size_t len);
+
+/**
+ * Length in bytes of the app image at offset 0 of a partition of
+ * `partitionSize` bytes. False if there is no plausible image there.
+ */
+bool firmwareImageLength(ImageReader read, void* ctx, uint32_t partitionSize, uint32_t& length);
+
+/**
+ * Parse a published digest: GitHub's "sha256:<hex>", or a sha256sum line
+ * "<hex>  firmware.bin". Hex digits in either case.
+ */
+bool parseSha256Hex(const char* text, uint8_t digest[SHA256_DIGEST_LEN]);
+
+// Lowercase hex into `out` (SHA256_HEX_LEN + 1 bytes)
+void formatSha256Hex(const uint8_t digest[SHA256_DIGEST_LEN], char* out);
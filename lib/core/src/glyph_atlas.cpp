@@ -0,0 +1,87 @@
+#include "glyph_atlas.h"
+
+#include <string.h>
+
+static uint8_t readNibble(const uint8_t* buf, int16_t bufWidth, int16_t x, int16_t y) {
+  uint8_t b = buf[(y * bufWidth + x) >> 1];
+  return (x & 1) ? (b & 0x0F) : (b >> 4);
+}
+
+static void writeNibble(uint8_t* buf, int16_t bufWidth, int16_t x, int16_t y, uint8_t value) {
+  uint8_t& b = buf[(y * bufWidth + x) >> 1];
+  b = (x & 1) ? (uint8_t)((b & 0xF0) | value) : (uint8_t)((b & 0x0F) | (value << 4));
+}
+
+void glyphAtlasReset(GlyphAtlas& atlas, uint8_t height) {
+  atlas.height = height;
+  atlas.count = 0;
+  atlas.used = 0;
+}
+
+bool glyphAtlasCapture(GlyphAtlas& atlas, char ch, const uint8_t* buf, int16_t bufWidth,
+                       int16_t bufHeight, int16_t x, int16_t y, uint8_t width, uint8_t ink) {
+  size_t stride = (width + 7) / 8;
+  size_t size = stride * atlas.height;
+  if (atlas.count >= GLYPH_ATLAS_MAX_GLYPHS || atlas.used + size > sizeof(atlas.bits)) return false;
+  if (x < 0 || y < 0 || x + width > bufWidth || y + atlas.height > bufHeight) return false;
+
+  uint8_t* bits = atlas.bits + atlas.used;
+  memset(bits, 0, size);
+  for (int16_t row = 0; row < atlas.height; row++) {
+    for (int16_t col = 0; col < width; col++) {
+      if (readNibble(buf, bufWidth, x + col, y + row) == ink) {
+        bits[row * stride + col / 8] |= 0x80 >> (col & 7);
+      }
+    }
+  }
+
+  GlyphInfo& glyph = atlas.glyphs[atlas.count++];
+  glyph.ch = ch;
+  glyph.width = width;
+  glyph.offset = atlas.used;
+  atlas.used += size;
+  return true;
+}
+
+const GlyphInfo* glyphAtlasFind(const GlyphAtlas& atlas, char ch) {
+  for (uint8_t i = 0; i < atlas.count; i++) {
+    if (atlas.glyphs[i].ch == ch) return &atlas.glyphs[i];
+  }
+  return NULL;
+}
+
+void glyphAtlasDraw(const GlyphAtlas& atlas, const GlyphInfo& glyph, uint8_t* buf, int16_t bufWidth,
+                    int16_t bufHeight, int16_t x, int16_t y, uint8_t ink, uint8_t background) {
+  int16_t col0 = (x < 0) ? -x : 0;
+  int16_t col1 = (x + glyph.width > bufWidth) ? bufWidth - x : glyph.width;
+  int16_t row0 = (y < 0) ? -y : 0;
+  int16_t row1 = (y + atlas.height > bufHeight) ? bufHeight - y : atlas.height;
+  if (col1 <= col0 || row1 <= row0) return;
+
+  // Two source bits -> one destination byte when both sides are pair-aligned
+  uint8_t pairs[4];
+  pairs[0] = (uint8_t)(background << 4 | background);
+  pairs[1] = (uint8_t)(background << 4 | ink);
+  pairs[2] = (uint8_t)(ink << 4 | background);
+  pairs[3] = (uint8_t)(ink << 4 | ink);
+  bool aligned = ((x + col0) & 1) == 0 && (col0 & 1) == 0;
+
+  size_t stride = (glyph.width + 7) / 8;
+  const uint8_t* bits = atlas.bits + glyph.offset;
+
+  for (int16_t row = row0; row < row1; row++) {
+    const uint8_t* src = bits + row * stride;
+    int16_t col = col0;
+
+    if (aligned) {
+      uint8_t* dst = buf + ((y + row) * bufWidth + x + col) / 2;
+      for (; col + 1 < col1; col += 2) {
+        *dst++ = pairs[(src[col / 8] >> (6 - (col & 7))) & 3];
+      }
+    }
+    for (; col < col1; col++) {
+      bool set = src[col / 8] & (0x80 >> (col & 7));
+      writeNibble(buf, bufWidth, x + col, y + row, set ? ink : background);
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+ * Pre-rasterized glyph cache for a 4-bit paletted frame buffer
+ *
+ * A handful of glyphs (the price digits) are captured once from a buffer
+ * they were drawn into, packed at one bit per pixel, and later painted
+ * back with any ink/background pair straight into the buffer. That skips
+ * the font's RLE decode and per-run fills on every redraw.
+ *
+ * Buffers use the TFT_eSprite 4-bit layout: two pixels per byte, even x
+ * in the high nibble, rows of bufWidth / 2 bytes (bufWidth is even).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GLYPH_ATLAS_MAX_GLYPHS 12
+#define GLYPH_ATLAS_BYTES      2560   // 11 font 6 glyphs need ~2.1 KB
+
+struct GlyphInfo {
+  char ch;
+  uint8_t width;
+  uint16_t offset;  // Into GlyphAtlas::bits, rows of (width + 7) / 8 bytes, MSB first
+};
+
+struct GlyphAtlas {
+  uint8_t height;
+  uint8_t count;
+  uint16_t used;
+  GlyphInfo glyphs[GLYPH_ATLAS_MAX_GLYPHS];
+  uint8_t bits[GLYPH_ATLAS_BYTES];
+};
+
+void glyphAtlasReset(GlyphAtlas& atlas, uint8_t height);
+
+/**
+ * Add the `width` x atlas.height cell at (x, y) of `buf` as glyph `ch`;
+ * pixels equal to `ink` become set bits. False when the atlas is full or
+ * the cell lies outside the buffer.
+ */
+bool glyphAtlasCapture(GlyphAtlas& atlas, char ch, const uint8_t* buf, int16_t bufWidth,
+                       int16_t bufHeight, int16_t x, int16_t y, uint8_t width, uint8_t ink);
+
+// NULL if `ch` was not captured
+const GlyphInfo* glyphAtlasFind(const GlyphAtlas& atlas, char ch);
+
+// Paint the whole cell of `glyph` (ink and background) at (x, y), clipped to the buffer
+void glyphAtlasDraw(const GlyphAtlas& atlas, const GlyphInfo& glyph, uint8_t* buf, int16_t bufWidth,
+                    int16_t bufHeight, int16_t x, int16_t y, uint8_t ink, uint8_t background);
@@ -0,0 +1,157 @@
+#include "http_response.h"
+
+#include <ctype.h>
+#include <string.h>
+
+// Case-insensitive match of a header name; returns the trimmed value or NULL
+static const char* headerValue(const char* line, const char* name) {
+  size_t i = 0;
+  for (; name[i]; i++) {
+    if (tolower((unsigned char)line[i]) != name[i]) return NULL;
+  }
+  if (line[i] != ':') return NULL;
+
+  const char* value = line + i + 1;
+  while (*value == ' ' || *value == '\t') value++;
+  return value;
+}
+
+static void copyTrimmed(char* dest, size_t destLen, const char* value) {
+  size_t len = strlen(value);
+  while (len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t')) len--;
+  if (len >= destLen) {
+    dest[0] = '\0';  // A truncated validator would never match - drop it
+    return;
+  }
+  memcpy(dest, value, len);
+  dest[len] = '\0';
+}
+
+static bool containsToken(const char* value, const char* token) {
+  size_t tokenLen = strlen(token);
+  for (const char* p = value; *p; p++) {
+    size_t i = 0;
+    while (i < tokenLen && tolower((unsigned char)p[i]) == token[i]) i++;
+    if (i == tokenLen) return true;
+  }
+  return false;
+}
+
+void httpResetHead(HttpResponseHead& head) {
+  memset(&head, 0, sizeof(head));
+  head.contentLength = -1;
+}
+
+// Non-negative decimal that fits int32_t, surrounded by optional whitespace
+static bool parseLength(const char* value, int32_t& out) {
+  int32_t n = 0;
+  const char* p = value;
+  if (!isdigit((unsigned char)*p)) return false;
+  for (; isdigit((unsigned char)*p); p++) {
+    if (n > (INT32_MAX - (*p - '0')) / 10) return false;
+    n = n * 10 + (*p - '0');
+  }
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p) return false;
+  out = n;
+  return true;
+}
+
+static int parseStatusLine(const char* line) {
+  // "HTTP/1.1 304 Not Modified"
+  if (strncmp(line, "HTTP/", 5) != 0) return -1;
+  const char* p = strchr(line, ' ');
+  if (!p) return -1;
+  while (*p == ' ') p++;
+
+  int status = 0;
+  for (int i = 0; i < 3; i++) {
+    if (!isdigit((unsigned char)p[i])) return -1;
+    status = status * 10 + (p[i] - '0');
+  }
+  return status;
+}
+
+bool httpParseHeadLine(HttpResponseHead& head, const char* line) {
+  if (line[0] == '\0') return false;
+
+  if (head.status == 0) {
+    head.status = parseStatusLine(line);
+    return true;
+  }
+
+  const char* value;
+  if ((value = headerValue(line, "transfer-encoding")) != NULL) {
+    head.chunked = containsToken(value, "chunked");
+  } else if ((value = headerValue(line, "etag")) != NULL) {
+    copyTrimmed(head.etag, sizeof(head.etag), value);
+  } else if ((value = headerValue(line, "last-modified")) != NULL) {
+    copyTrimmed(head.lastModified, sizeof(head.lastModified), value);
+  } else if ((value = headerValue(line, "date")) != NULL) {
+    copyTrimmed(head.date, sizeof(head.date), value);
+  } else if ((value = headerValue(line, "content-length")) != NULL) {
+    if (!parseLength(value, head.contentLength)) head.contentLength = -1;
+  } else if ((value = headerValue(line, "retry-after")) != NULL) {
+    copyTrimmed(head.retryAfter, sizeof(head.retryAfter), value);
+  } else if ((value = headerValue(line, "sec-websocket-accept")) != NULL) {
+    copyTrimmed(head.webSocketAccept, sizeof(head.webSocketAccept), value);
+  }
+  return true;
+}
+
+static bool parseDigits(const char* p, int count, int& out) {
+  out = 0;
+  for (int i = 0; i < count; i++) {
+    if (!isdigit((unsigned char)p[i])) return false;
+    out = out * 10 + (p[i] - '0');
+  }
+  return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Howard Hinnant's days_from_civil)
+static int32_t daysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  int32_t era = year / 400;
+  int32_t yoe = year - era * 400;
+  int32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+bool httpParseDate(const char* value, uint32_t& unixTime) {
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+  // "Sun, 06 Nov 1994 08:49:37 GMT"
+  //  0    5  8   12   17 20 23 26
+  if (strlen(value) < 29 || value[3] != ',' || strncmp(value + 26, "GMT", 3) != 0) return false;
+
+  int day, year, hour, minute, second;
+  if (!parseDigits(value + 5, 2, day) || !parseDigits(value + 12, 4, year) ||
+      !parseDigits(value + 17, 2, hour) || !parseDigits(value + 20, 2, minute) ||
+      !parseDigits(value + 23, 2, second)) {
+    return false;
+  }
+
+  int month = 0;
+  while (month < 12 && strncmp(months + month * 3, value + 8, 3) != 0) month++;
+  if (month == 12 || year < 1970 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+
+  int32_t days = daysFromCivil(year, month + 1, day);
+  unixTime = (uint32_t)days * 86400u + hour * 3600u + minute * 60u + second;
+  return true;
+}
+
+bool httpRetryAfterSeconds(const HttpResponseHead& head, uint32_t& seconds) {
+  int32_t delta;
+  if (parseLength(head.retryAfter, delta)) {
+    seconds = (uint32_t)delta;
+    return true;
+  }
+
+  uint32_t until, now;
+  if (!httpParseDate(head.retryAfter, until) || !httpParseDate(head.date, now)) return false;
+  seconds = until > now ? until - now : 0;
+  return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+/**
+ * Allocation-free HTTP/1.1 response head parser
+ *
+ * Fed one line at a time (CR/LF already stripped) into a fixed struct.
+ * Hardware-independent; the socket side lives in HttpBodyStream.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HTTP_ETAG_MAX_LEN 96   // GitHub weak ETags are W/"<64 hex>"
+#define HTTP_DATE_MAX_LEN 32   // IMF-fixdate is 29 characters
+#define HTTP_WS_ACCEPT_MAX_LEN 32   // Base64 SHA-1 is 28 characters
+
+struct HttpResponseHead {
+  int status;                           // 0 = no status line yet, -1 = malformed
+  bool chunked;
+  int32_t contentLength;                // -1 = not sent (read to close or last chunk)
+  char etag[HTTP_ETAG_MAX_LEN];
+  char lastModified[HTTP_DATE_MAX_LEN];
+  char date[HTTP_DATE_MAX_LEN];         // Server clock, used to set the RTC
+  char retryAfter[HTTP_DATE_MAX_LEN];   // Raw value, see httpRetryAfterSeconds()
+  char webSocketAccept[HTTP_WS_ACCEPT_MAX_LEN];  // Sec-WebSocket-Accept of a 101 upgrade
+};
+
+void httpResetHead(HttpResponseHead& head);
+
+/**
+ * Parse one line of the response head.
+ * Returns false on the blank line that ends the head, true otherwise.
+ */
+bool httpParseHeadLine(HttpResponseHead& head, const char* line);
+
+/**
+ * Convert an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") to Unix
+ * seconds. Returns false for anything else, including the obsolete
+ * RFC 850 and asctime forms.
+ */
+bool httpParseDate(const char* value, uint32_t& unixTime);
+
+/**
+ * Seconds the server asked us to wait: Retry-After as delta-seconds, or
+ * as an HTTP-date relative to the response's own Date header (so the
+ * result does not depend on our clock). False if absent or unusable.
+ */
+bool httpRetryAfterSeconds(const HttpResponseHead& head, uint32_t& seconds);
@@ -0,0 +1,34 @@
+#include "memory_watermark.h"
+
+static const char* const MEMORY_PHASE_NAMES[MEM_PHASE_COUNT] = {
+  "idle", "tls", "parse", "ota"
+};
+
+const char* memoryPhaseName(uint8_t phase) {
+  return phase < MEM_PHASE_COUNT ? MEMORY_PHASE_NAMES[phase] : "?";
+}
+
+void memoryReset(MemoryWatermarks& w) {
+  for (uint8_t p = 0; p < MEM_PHASE_COUNT; p++) {
+    w.phase[p].samples = 0;
+    w.phase[p].minFree = UINT32_MAX;
+    w.phase[p].minLargestBlock = UINT32_MAX;
+    w.phase[p].maxFragmentation = 0;
+  }
+}
+
+uint8_t heapFragmentation(uint32_t freeBytes, uint32_t largestBlock) {
+  if (freeBytes == 0) return 0;
+  if (largestBlock >= freeBytes) return 0;
+  return (uint8_t)(100 - (uint64_t)largestBlock * 100 / freeBytes);
+}
+
+void memoryRecord(MemoryWatermarks& w, uint8_t phase, uint32_t freeBytes, uint32_t largestBlock) {
+  if (phase >= MEM_PHASE_COUNT) return;
+  MemoryPeak& peak = w.phase[phase];
+  peak.samples++;
+  if (freeBytes < peak.minFree) peak.minFree = freeBytes;
+  if (largestBlock < peak.minLargestBlock) peak.minLargestBlock = largestBlock;
+  uint8_t fragmentation = heapFragmentation(freeBytes, largestBlock);
+  if (fragmentation > peak.maxFragmentation) peak.maxFragmentation = fragmentation;
+}
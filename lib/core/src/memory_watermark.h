@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+ * Heap watermarks per phase
+ *
+ * Keeps the worst free heap, smallest largest-free-block and highest
+ * fragmentation seen in each memory-hungry phase (TLS session up, JSON
+ * parse, OTA download) plus idle with the radio off. Fragmentation is the
+ * share of free heap outside the largest free block: mbedTLS allocates
+ * its record buffers in one piece, so a shrinking largest block predicts
+ * a failing handshake long before free heap runs out. Byte counts are
+ * passed in so this builds on the host.
+ */
+
+#include <stdint.h>
+
+enum MemoryPhase : uint8_t {
+  MEM_PHASE_IDLE,    // Radio off, between network jobs
+  MEM_PHASE_TLS,     // TLS session established
+  MEM_PHASE_PARSE,   // JSON document still alive after the parse
+  MEM_PHASE_OTA,     // Firmware download in flight
+  MEM_PHASE_COUNT
+};
+
+const char* memoryPhaseName(uint8_t phase);
+
+struct MemoryPeak {
+  uint32_t samples;
+  uint32_t minFree;
+  uint32_t minLargestBlock;
+  uint8_t maxFragmentation;   // Percent
+};
+
+struct MemoryWatermarks {
+  MemoryPeak phase[MEM_PHASE_COUNT];
+};
+
+void memoryReset(MemoryWatermarks& w);
+void memoryRecord(MemoryWatermarks& w, uint8_t phase, uint32_t freeBytes, uint32_t largestBlock);
+
+// Percent of free heap not in the largest block, 0 when nothing is free
+uint8_t heapFragmentation(uint32_t freeBytes, uint32_t largestBlock);
@@ -0,0 +1,103 @@
+#include "price_format.h"
+
+size_t formatGroupedInteger(char* out, size_t size, uint32_t value) {
+  // Digits are produced backwards into a scratch buffer, then copied out
+  char scratch[PRICE_FORMAT_MAX_LEN];
+  size_t n = 0;
+  int digits = 0;
+  do {
+    if (digits > 0 && digits % 3 == 0) scratch[n++] = ',';
+    scratch[n++] = (char)('0' + value % 10);
+    value /= 10;
+    digits++;
+  } while (value > 0);
+
+  if (size == 0) return 0;
+  if (n + 1 > size) {
+    out[0] = '\0';
+    return 0;
+  }
+  for (size_t i = 0; i < n; i++) {
+    out[i] = scratch[n - 1 - i];
+  }
+  out[n] = '\0';
+  return n;
+}
+
+size_t formatPriceWithCommas(char* out, size_t size, float price) {
+  if (size < 2) {
+    if (size) out[0] = '\0';
+    return 0;
+  }
+
+  // NaN fails both comparisons; anything past 32 bits is clamped
+  uint32_t whole = 0;
+  if (price >= 4294967295.0f) {
+    whole = UINT32_MAX;
+  } else if (price >= 1.0f) {
+    whole = (uint32_t)price;
+  }
+
+  out[0] = '$';
+  size_t n = formatGroupedInteger(out + 1, size - 1, whole);
+  if (n == 0) {
+    out[0] = '\0';
+    return 0;
+  }
+  return n + 1;
+}
+
+size_t formatMillivolts(char* out, size_t size, uint16_t millivolts) {
+  uint32_t centivolts = (millivolts + 5u) / 10;
+  uint32_t volts = centivolts / 100;
+  uint32_t fraction = centivolts % 100;
+
+  // Integer part, '.', two fraction digits, 'V'
+  size_t intDigits = volts >= 10 ? 2 : 1;
+  size_t len = intDigits + 4;
+  if (size < len + 1) {
+    if (size) out[0] = '\0';
+    return 0;
+  }
+
+  size_t n = 0;
+  if (volts >= 10) out[n++] = (char)('0' + volts / 10);
+  out[n++] = (char)('0' + volts % 10);
+  out[n++] = '.';
+  out[n++] = (char)('0' + fraction / 10);
+  out[n++] = (char)('0' + fraction % 10);
+  out[n++] = 'V';
+  out[n] = '\0';
+  return n;
+}
+
+size_t formatAge(char* out, size_t size, uint32_t seconds) {
+  uint32_t value = seconds;
+  char unit = 's';
+  if (seconds >= 86400) {
+    value = seconds / 86400;
+    unit = 'd';
+  } else if (seconds >= 3600) {
+    value = seconds / 3600;
+    unit = 'h';
+  } else if (seconds >= 60) {
+    value = seconds / 60;
+    unit = 'm';
+  }
+
+  char digits[10];
+  size_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+
+  if (size < count + 2) {
+    if (size) out[0] = '\0';
+    return 0;
+  }
+  for (size_t i = 0; i < count; i++) out[i] = digits[count - 1 - i];
+  out[count] = unit;
+  out[count + 1] = '\0';
+  return count + 1;
+}
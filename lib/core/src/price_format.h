@@ -0,0 +1,39 @@
+#pragma once
+
+/**
+ * Stack-buffer number formatting for the display
+ *
+ * Digit grouping is done by hand (no snprintf, no String) so drawing a
+ * price never touches the heap.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRICE_FORMAT_MAX_LEN   16  // "$4,294,967,295" + NUL
+#define VOLTAGE_FORMAT_MAX_LEN 8   // "65.53V" + NUL
+#define AGE_FORMAT_MAX_LEN     8   // "49710d" + NUL
+
+/**
+ * Write `value` with thousands separators ("67,012") into `out`.
+ * Returns the length, or 0 (and an empty string) if it does not fit.
+ */
+size_t formatGroupedInteger(char* out, size_t size, uint32_t value);
+
+/**
+ * "$67,012": the whole-dollar part of `price` grouped, with a leading
+ * "$". Negative and non-finite prices format as "$0".
+ */
+size_t formatPriceWithCommas(char* out, size_t size, float price);
+
+/**
+ * "3.87V": millivolts rounded to two decimals, as the status corner and
+ * the battery log lines show them.
+ */
+size_t formatMillivolts(char* out, size_t size, uint16_t millivolts);
+
+/**
+ * "45s", "12m", "3h", "2d": an age in its largest whole unit, for the
+ * stale-price label.
+ */
+size_t formatAge(char* out, size_t size, uint32_t seconds);
@@ -0,0 +1,103 @@
+#include "price_history.h"
+
+#include <string.h>
+
+void historyReset(PriceHistory& h, uint32_t windowSeconds) {
+  memset(&h, 0, sizeof(h));
+  h.magic = PRICE_HISTORY_MAGIC;
+  h.window = windowSeconds;
+}
+
+bool historyValid(const PriceHistory& h) {
+  return h.magic == PRICE_HISTORY_MAGIC && h.count <= PRICE_HISTORY_CAPACITY &&
+         h.head < PRICE_HISTORY_CAPACITY && h.windowCount <= h.count;
+}
+
+const PriceSample& historyAt(const PriceHistory& h, size_t i) {
+  size_t oldest = (h.head + PRICE_HISTORY_CAPACITY - h.count) % PRICE_HISTORY_CAPACITY;
+  return h.samples[(oldest + i) % PRICE_HISTORY_CAPACITY];
+}
+
+const PriceSample* historyNewest(const PriceHistory& h) {
+  return h.count ? &historyAt(h, h.count - 1) : NULL;
+}
+
+size_t historyWindowStart(const PriceHistory& h) {
+  return h.count - h.windowCount;
+}
+
+// A sample leaving the window only matters if it was one of the extremes
+static void leaveWindow(PriceHistory& h, const PriceSample& s) {
+  h.windowCount--;
+  if (s.cents == h.minCents || s.cents == h.maxCents) h.extremesStale = true;
+}
+
+bool historyPush(PriceHistory& h, uint32_t time, uint32_t cents) {
+  const PriceSample* newest = historyNewest(h);
+  if (newest && time <= newest->time) return false;
+
+  // Overwriting the oldest slot evicts it from the window too
+  if (h.count == PRICE_HISTORY_CAPACITY) {
+    if (h.windowCount == h.count) leaveWindow(h, historyAt(h, 0));
+    h.count--;
+  }
+
+  h.samples[h.head] = { time, cents };
+  h.head = (h.head + 1) % PRICE_HISTORY_CAPACITY;
+  h.count++;
+
+  if (h.windowCount == 0) {
+    h.minCents = cents;
+    h.maxCents = cents;
+    h.extremesStale = false;
+  } else if (!h.extremesStale) {
+    if (cents < h.minCents) h.minCents = cents;
+    if (cents > h.maxCents) h.maxCents = cents;
+  }
+  h.windowCount++;
+
+  // Age out samples that fell behind the window
+  while (h.windowCount > 1) {
+    const PriceSample& first = historyAt(h, historyWindowStart(h));
+    if (time - first.time <= h.window) break;
+    leaveWindow(h, first);
+  }
+
+  h.version++;
+  return true;
+}
+
+bool historyRange(PriceHistory& h, uint32_t& minCents, uint32_t& maxCents) {
+  if (h.windowCount == 0) return false;
+
+  if (h.extremesStale) {
+    size_t start = historyWindowStart(h);
+    h.minCents = UINT32_MAX;
+    h.maxCents = 0;
+    for (size_t i = start; i < h.count; i++) {
+      uint32_t c = historyAt(h, i).cents;
+      if (c < h.minCents) h.minCents = c;
+      if (c > h.maxCents) h.maxCents = c;
+    }
+    h.extremesStale = false;
+  }
+
+  minCents = h.minCents;
+  maxCents = h.maxCents;
+  return true;
+}
+
+uint32_t historyRecentMoveBp(const PriceHistory& h, uint32_t seconds) {
+  const PriceSample* newest = historyNewest(h);
+  if (newest == NULL || newest->cents == 0) return 0;
+
+  uint32_t lo = newest->cents, hi = newest->cents;
+  for (size_t i = h.count - 1; i-- > 0;) {
+    const PriceSample& s = historyAt(h, i);
+    // The previous sample always counts: the refresh interval itself can exceed the window
+    if (i + 2 < h.count && newest->time - s.time > seconds) break;
+    if (s.cents < lo) lo = s.cents;
+    if (s.cents > hi) hi = s.cents;
+  }
+  return (uint32_t)((uint64_t)(hi - lo) * 10000 / newest->cents);
+}
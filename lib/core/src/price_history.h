@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Fixed-size ring of timestamped price samples
+ *
+ * 8 bytes per sample (Unix seconds + integer cents), so a few KB hold a
+ * week of history and the whole ring can live in RTC slow memory across
+ * deep sleep. The min/max over the chart window is updated on every push;
+ * only evicting the current extreme forces a rescan, deferred until the
+ * range is next read. Plain aggregate without constructors so it can be
+ * declared RTC_DATA_ATTR and persisted as a blob.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRICE_HISTORY_CAPACITY 256          // 2 KB of samples
+#define PRICE_HISTORY_MAGIC    0x50480001u  // "PH" + layout version
+
+struct PriceSample {
+  uint32_t time;   // Unix seconds
+  uint32_t cents;  // Fixed-point price in 0.01 units
+};
+
+struct PriceHistory {
+  uint32_t magic;
+  uint32_t window;        // Seconds before the newest sample covered by the range
+  uint16_t head;          // Slot the next sample goes into
+  uint16_t count;
+  uint16_t windowCount;   // Newest samples that fall inside the window
+  bool extremesStale;
+  uint32_t minCents;
+  uint32_t maxCents;
+  uint32_t version;       // Bumped on every change, for redraw tracking
+  PriceSample samples[PRICE_HISTORY_CAPACITY];
+};
+
+void historyReset(PriceHistory& h, uint32_t windowSeconds);
+bool historyValid(const PriceHistory& h);
+
+/**
+ * Append a sample. Samples must arrive in time order; one that is not
+ * newer than the last sample is dropped and false is returned.
+ */
+bool historyPush(PriceHistory& h, uint32_t time, uint32_t cents);
+
+// i = 0 is the oldest sample in the ring
+const PriceSample& historyAt(const PriceHistory& h, size_t i);
+const PriceSample* historyNewest(const PriceHistory& h);
+
+// Ring index (as for historyAt) of the oldest sample inside the window
+size_t historyWindowStart(const PriceHistory& h);
+
+// Min/max of the window; false while it is empty
+bool historyRange(PriceHistory& h, uint32_t& minCents, uint32_t& maxCents);
+
+/**
+ * High-low range of the samples in the last `seconds` before the newest
+ * one, in basis points of the newest price (0 with fewer than two). The
+ * sample just before the newest is always included, however old, so a
+ * refresh interval longer than the window still sees the last move.
+ */
+uint32_t historyRecentMoveBp(const PriceHistory& h, uint32_t seconds);
@@ -0,0 +1,25 @@
+#include "refresh_policy.h"
+
+uint32_t refreshIntervalMs(const RefreshPolicy& p, bool externalPower, uint16_t batteryMv,
+                           uint32_t recentMoveBp) {
+  uint32_t interval;
+  if (externalPower) {
+    interval = p.pluggedMs;
+  } else if (batteryMv >= p.stretchFromMv) {
+    interval = p.batteryMs;
+  } else if (batteryMv <= p.stretchToMv) {
+    interval = p.maxMs;
+  } else {
+    uint32_t span = p.stretchFromMv - p.stretchToMv;
+    uint32_t sag = p.stretchFromMv - batteryMv;
+    interval = p.batteryMs + (uint32_t)((uint64_t)(p.maxMs - p.batteryMs) * sag / span);
+  }
+
+  if (recentMoveBp >= p.highMoveBp) {
+    interval /= 4;
+  } else if (recentMoveBp >= p.midMoveBp) {
+    interval /= 2;
+  }
+
+  return interval < p.minMs ? p.minMs : interval;
+}
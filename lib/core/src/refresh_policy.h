@@ -0,0 +1,27 @@
+#pragma once
+
+/**
+ * Adaptive price refresh interval
+ *
+ * Spends the radio budget where it buys the most freshness: a short
+ * interval on USB power, the normal interval on a healthy cell stretched
+ * linearly as the voltage sags towards the low threshold, and divided
+ * when the price history shows a large recent move. Pure function of its
+ * inputs so the scheduler can re-evaluate it on every deadline check.
+ */
+
+#include <stdint.h>
+
+struct RefreshPolicy {
+  uint32_t pluggedMs;      // Interval on external power
+  uint32_t batteryMs;      // Interval on a cell at or above stretchFromMv
+  uint32_t maxMs;          // Interval at or below stretchToMv
+  uint32_t minMs;          // Floor after the volatility divisor
+  uint16_t stretchFromMv;
+  uint16_t stretchToMv;
+  uint16_t midMoveBp;      // Recent move that halves the interval...
+  uint16_t highMoveBp;     // ...and one that quarters it
+};
+
+uint32_t refreshIntervalMs(const RefreshPolicy& p, bool externalPower, uint16_t batteryMv,
+                           uint32_t recentMoveBp);
@@ -0,0 +1,37 @@
+#include "rollout.h"
+
+// FNV-1a, then a murmur3 finalizer: MACs of one batch differ only in the
+// last bytes, and the low bits of plain FNV would cluster them
+static uint32_t hashId(const uint8_t* id, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= id[i];
+    h *= 16777619u;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+RolloutSlot rolloutSlot(const uint8_t* id, size_t len, uint32_t periodS, uint32_t slots) {
+  RolloutSlot result = { 0, 0 };
+  if (slots == 0) slots = 1;
+  if (slots > periodS) slots = periodS;
+  if (slots == 0) return result;
+
+  uint32_t h = hashId(id, len);
+  uint32_t slotLen = periodS / slots;
+  result.slot = h % slots;
+  result.offsetS = result.slot * slotLen + (h / slots) % slotLen;
+  return result;
+}
+
+uint32_t secondsUntilSlot(uint32_t now, uint32_t periodS, uint32_t offsetS, uint32_t minWaitS) {
+  if (periodS == 0) return minWaitS;
+
+  uint32_t phase = (now + minWaitS) % periodS;
+  return minWaitS + (offsetS % periodS + periodS - phase) % periodS;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+/**
+ * Deterministic per-device rollout slots
+ *
+ * A period (the firmware check interval) is cut into equal slots and each
+ * device gets a fixed offset inside it from a hash of its MAC. Timed
+ * against the wall clock, a fleet that powers up together after an outage
+ * still spreads its checks over the whole period, and every unit keeps
+ * the same time of day from one check to the next.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct RolloutSlot {
+  uint32_t slot;     // 0 .. slots - 1
+  uint32_t offsetS;  // Seconds into the period, inside that slot
+};
+
+// Slot and offset of the device identified by `id` (e.g. its 6-byte MAC)
+RolloutSlot rolloutSlot(const uint8_t* id, size_t len, uint32_t periodS, uint32_t slots);
+
+/**
+ * Seconds from `now` to the next instant that is `offsetS` into a
+ * `periodS` cycle and at least `minWaitS` away. Any time base works; Unix
+ * seconds line the cycle up across devices.
+ */
+uint32_t secondsUntilSlot(uint32_t now, uint32_t periodS, uint32_t offsetS, uint32_t minWaitS);
@@ -0,0 +1,15 @@
+#include "semver.h"
+
+static int compareComponent(int a, int b) {
+  return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+int compareSemanticVersion(const SemanticVersion& a, const SemanticVersion& b) {
+  if (a.major != b.major) return compareComponent(a.major, b.major);
+  if (a.minor != b.minor) return compareComponent(a.minor, b.minor);
+  return compareComponent(a.patch, b.patch);
+}
+
+int compareSemanticVersion(const char* v1, const char* v2) {
+  return compareSemanticVersion(parseSemanticVersion(v1), parseSemanticVersion(v2));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/**
+ * Semantic version parsing and comparison on plain C strings
+ *
+ * "MAJOR.MINOR.PATCH", missing components count as 0 and each component
+ * is read up to its first non-digit ("1.2.3-beta" is 1.2.3). A leading
+ * 'v'/'V' is not stripped here; release tags are trimmed by the caller.
+ */
+
+struct SemanticVersion {
+  int major;
+  int minor;
+  int patch;
+};
+
+// Single-expression helpers so the parse is constexpr under C++11
+constexpr bool semverIsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+constexpr int semverComponent(const char* p, int value = 0) {
+  return semverIsDigit(*p) ? semverComponent(p + 1, value * 10 + (*p - '0')) : value;
+}
+
+// Just past the next '.', or the terminating NUL if there is none
+constexpr const char* semverNext(const char* p) {
+  return *p == '\0' ? p : (*p == '.' ? p + 1 : semverNext(p + 1));
+}
+
+constexpr const char* semverSkipDigits(const char* p) {
+  return semverIsDigit(*p) ? semverSkipDigits(p + 1) : p;
+}
+
+/**
+ * True for exactly `components` dot-separated runs of digits, optionally
+ * followed by a "-pre" or "+build" suffix. parseSemanticVersion() is more
+ * lenient; this is what a version we publish must look like.
+ */
+constexpr bool semverWellFormed(const char* p, int components = 3) {
+  return semverIsDigit(*p) &&
+         (components == 1 ? (*semverSkipDigits(p) == '\0' || *semverSkipDigits(p) == '-' ||
+                             *semverSkipDigits(p) == '+')
+                          : (*semverSkipDigits(p) == '.' &&
+                             semverWellFormed(semverSkipDigits(p) + 1, components - 1)));
+}
+
+/**
+ * Usable at compile time, so FIRMWARE_VERSION is parsed (and checked)
+ * once by the compiler instead of on every release check.
+ */
+constexpr SemanticVersion parseSemanticVersion(const char* text) {
+  return SemanticVersion{semverComponent(text), semverComponent(semverNext(text)),
+                         semverComponent(semverNext(semverNext(text)))};
+}
+
+int compareSemanticVersion(const SemanticVersion& a, const SemanticVersion& b);
+
+/**
+ * Compare two semantic version strings (e.g., "1.2.3" vs "1.10.0")
+ * Returns: -1 if v1 < v2, 0 if v1 == v2, 1 if v1 > v2
+ */
+int compareSemanticVersion(const char* v1, const char* v2);
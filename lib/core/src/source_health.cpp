@@ -0,0 +1,64 @@
+#include "source_health.h"
+
+static void countSample(SourceHealth& h) {
+  if (h.samples < UINT16_MAX) h.samples++;
+}
+
+void sourceRecordSuccess(SourceHealth& h, uint32_t latencyMs) {
+  h.latencyMs = (h.samples == 0 || h.latencyMs == 0) ? latencyMs
+                                                    : h.latencyMs - h.latencyMs / 4 + latencyMs / 4;
+  h.errorScore -= h.errorScore / 4;
+  h.consecutiveFailures = 0;
+  h.backoffUntil = 0;
+  countSample(h);
+}
+
+void sourceRecordFailure(SourceHealth& h, uint32_t now, uint32_t minBackoffMs) {
+  h.errorScore = h.errorScore - h.errorScore / 4 + SOURCE_ERROR_SCALE / 4;
+  countSample(h);
+
+  uint32_t backoff = SOURCE_BACKOFF_BASE_MS;
+  for (uint8_t i = 0; i < h.consecutiveFailures && backoff < SOURCE_BACKOFF_MAX_MS; i++) {
+    backoff *= 2;
+  }
+  if (backoff > SOURCE_BACKOFF_MAX_MS) backoff = SOURCE_BACKOFF_MAX_MS;
+  if (backoff < minBackoffMs) backoff = minBackoffMs;
+
+  if (h.consecutiveFailures < UINT8_MAX) h.consecutiveFailures++;
+  h.backoffUntil = now + backoff;
+  if (h.backoffUntil == 0) h.backoffUntil = 1;  // 0 means "available"
+}
+
+void sourceRecordRetryAfter(SourceHealth& h, uint32_t now, uint32_t retryAfterMs) {
+  h.errorScore = h.errorScore - h.errorScore / 4 + SOURCE_ERROR_SCALE / 4;
+  countSample(h);
+  h.backoffUntil = now + retryAfterMs;
+  if (h.backoffUntil == 0) h.backoffUntil = 1;
+}
+
+bool sourceAvailable(const SourceHealth& h, uint32_t now) {
+  return h.backoffUntil == 0 || (int32_t)(now - h.backoffUntil) >= 0;
+}
+
+uint32_t sourceCost(const SourceHealth& h) {
+  uint32_t latency = h.latencyMs ? h.latencyMs : SOURCE_UNTRIED_LATENCY_MS;
+  // A source failing every request costs 4x its latency
+  return latency + (uint32_t)((uint64_t)latency * 3 * h.errorScore / SOURCE_ERROR_SCALE);
+}
+
+size_t rankSources(const SourceHealth* health, size_t count, uint32_t now, uint8_t* order) {
+  size_t n = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!sourceAvailable(health[i], now)) continue;
+
+    // Insertion sort; the table has a handful of entries
+    uint32_t cost = sourceCost(health[i]);
+    size_t j = n++;
+    while (j > 0 && sourceCost(health[order[j - 1]]) > cost) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = (uint8_t)i;
+  }
+  return n;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+ * Per-source health scoring for price-source failover
+ *
+ * Each source keeps an EWMA of its request latency and of its failure
+ * rate, plus a backoff deadline. rankSources() orders the sources that
+ * are not backing off by expected cost, so the caller can try the
+ * fastest healthy one first and fall through to the rest in the same
+ * WiFi session. Plain aggregate so the table can be RTC_DATA_ATTR.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SOURCE_UNTRIED_LATENCY_MS 2000    // Assumed cost of a source with no samples yet
+#define SOURCE_ERROR_SCALE        1000    // errorScore is fixed-point 0..1000
+#define SOURCE_BACKOFF_BASE_MS    300000  // First failure parks a source for 5 minutes...
+#define SOURCE_BACKOFF_MAX_MS     3600000 // ...doubling up to an hour
+
+struct SourceHealth {
+  uint32_t latencyMs;            // EWMA (1/4) of successful request times
+  uint16_t errorScore;           // EWMA (1/4) of failures, 0..SOURCE_ERROR_SCALE
+  uint16_t samples;              // Requests seen (saturating)
+  uint8_t consecutiveFailures;
+  uint32_t backoffUntil;         // Uptime ms; 0 = available
+};
+
+void sourceRecordSuccess(SourceHealth& h, uint32_t latencyMs);
+
+/**
+ * Record a failed request at uptime `now`. The source backs off for
+ * `minBackoffMs` (e.g. a server's Retry-After) or its exponential
+ * failure backoff, whichever is longer.
+ */
+void sourceRecordFailure(SourceHealth& h, uint32_t now, uint32_t minBackoffMs);
+
+/**
+ * Record a rate-limited request that carried Retry-After: counted as a
+ * failure for the score, but the source is parked for exactly the time
+ * the server asked for.
+ */
+void sourceRecordRetryAfter(SourceHealth& h, uint32_t now, uint32_t retryAfterMs);
+
+bool sourceAvailable(const SourceHealth& h, uint32_t now);
+
+// Expected cost: latency inflated by the failure rate (lower is better)
+uint32_t sourceCost(const SourceHealth& h);
+
+/**
+ * Write the indices of available sources into `order`, cheapest first
+ * (ties keep table order). Returns how many were written.
+ */
+size_t rankSources(const SourceHealth* health, size_t count, uint32_t now, uint8_t* order);
@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+ * Lock-free single-producer / single-consumer ring queue
+ *
+ * Exactly one task pushes and exactly one task pops. The tail index is
+ * only written by the producer and the head only by the consumer, each
+ * published with release ordering, so no lock or critical section is
+ * needed even across the two ESP32 cores. One slot stays empty to tell
+ * full from empty: N slots hold N - 1 items.
+ */
+
+#include <atomic>
+#include <stddef.h>
+
+template <typename T, size_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  // Producer side; false (item dropped) when the queue is full
+  bool push(const T& item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) & (N - 1);
+    if (next == _head.load(std::memory_order_acquire)) return false;
+
+    _items[tail] = item;
+    _tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side; false when empty
+  bool pop(T& item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) return false;
+
+    item = _items[head];
+    _head.store((head + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T _items[N];
+  std::atomic<size_t> _head{0};
+  std::atomic<size_t> _tail{0};
+};
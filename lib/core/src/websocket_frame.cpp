@@ -0,0 +1,156 @@
+#include "websocket_frame.h"
+
+#include <string.h>
+
+WebSocketDecoder::WebSocketDecoder(uint8_t* buffer, size_t capacity)
+    : _buffer(buffer), _capacity(capacity) {
+  reset();
+}
+
+void WebSocketDecoder::reset() {
+  _state = HEADER;
+  _fin = false;
+  _opcode = 0;
+  _extBytes = 0;
+  _remaining = 0;
+  _inMessage = false;
+  _messageOpcode = 0;
+  _messageLen = 0;
+  _truncated = false;
+  _controlLen = 0;
+}
+
+static bool isControl(uint8_t opcode) {
+  return opcode & 0x8;
+}
+
+// Header complete: check the frame against the message state
+WebSocketEvent WebSocketDecoder::startPayload() {
+  if (isControl(_opcode)) {
+    if (!_fin || _remaining > WS_CONTROL_MAX_LEN) return WS_EVENT_ERROR;
+    _controlLen = 0;
+  } else if (_opcode == WS_OP_CONTINUATION) {
+    if (!_inMessage) return WS_EVENT_ERROR;
+  } else {
+    if (_inMessage) return WS_EVENT_ERROR;  // New message before the last one finished
+    _inMessage = true;
+    _messageOpcode = _opcode;
+    _messageLen = 0;
+    _truncated = false;
+  }
+
+  _state = PAYLOAD;
+  return (_remaining == 0) ? endFrame() : WS_EVENT_NONE;
+}
+
+WebSocketEvent WebSocketDecoder::endFrame() {
+  _state = HEADER;
+  if (isControl(_opcode)) return WS_EVENT_CONTROL;
+  if (!_fin) return WS_EVENT_NONE;
+  _inMessage = false;
+  return WS_EVENT_MESSAGE;
+}
+
+size_t WebSocketDecoder::feed(const uint8_t* data, size_t len, WebSocketEvent& event) {
+  event = WS_EVENT_NONE;
+  size_t i = 0;
+
+  while (i < len && event == WS_EVENT_NONE && _state != FAILED) {
+    uint8_t b = data[i];
+    switch (_state) {
+      case HEADER:
+        _fin = b & 0x80;
+        _opcode = b & 0x0F;
+        // No extensions negotiated, so RSV bits must be clear; 3-7 and 0xB-0xF are reserved
+        if ((b & 0x70) || (_opcode > WS_OP_BINARY && _opcode < WS_OP_CLOSE) || _opcode > WS_OP_PONG) {
+          event = WS_EVENT_ERROR;
+          break;
+        }
+        _state = LENGTH;
+        i++;
+        break;
+
+      case LENGTH:
+        i++;
+        if (b & 0x80) {  // Servers must not mask
+          event = WS_EVENT_ERROR;
+          break;
+        }
+        _remaining = b & 0x7F;
+        if (_remaining == 126 || _remaining == 127) {
+          _extBytes = (_remaining == 126) ? 2 : 8;
+          _remaining = 0;
+          _state = LENGTH_EXT;
+        } else {
+          event = startPayload();
+        }
+        break;
+
+      case LENGTH_EXT:
+        i++;
+        _remaining = (_remaining << 8) | b;
+        if (--_extBytes == 0) {
+          if (_remaining >> 63) {
+            event = WS_EVENT_ERROR;
+            break;
+          }
+          event = startPayload();
+        }
+        break;
+
+      case PAYLOAD: {
+        size_t n = len - i;
+        if (n > _remaining) n = (size_t)_remaining;
+
+        if (isControl(_opcode)) {
+          memcpy(_control + _controlLen, data + i, n);
+          _controlLen += n;
+        } else if (!_truncated && _messageLen + n <= _capacity) {
+          memcpy(_buffer + _messageLen, data + i, n);
+          _messageLen += n;
+        } else {
+          _truncated = true;  // Keep reading the frame, drop its bytes
+        }
+
+        i += n;
+        _remaining -= n;
+        if (_remaining == 0) event = endFrame();
+        break;
+      }
+
+      case FAILED:
+        break;
+    }
+  }
+
+  if (event == WS_EVENT_ERROR) _state = FAILED;
+  return i;
+}
+
+size_t webSocketEncodeFrame(uint8_t* out, size_t outSize, uint8_t opcode,
+                            const uint8_t* payload, size_t len, uint32_t maskKey) {
+  size_t header = 2 + 4;
+  if (len >= 126) header += (len > 0xFFFF) ? 8 : 2;
+  if (outSize < header + len) return 0;
+
+  size_t o = 0;
+  out[o++] = 0x80 | (opcode & 0x0F);
+  if (len < 126) {
+    out[o++] = 0x80 | (uint8_t)len;
+  } else if (len <= 0xFFFF) {
+    out[o++] = 0x80 | 126;
+    out[o++] = (uint8_t)(len >> 8);
+    out[o++] = (uint8_t)len;
+  } else {
+    out[o++] = 0x80 | 127;
+    for (int shift = 56; shift >= 0; shift -= 8) out[o++] = (uint8_t)((uint64_t)len >> shift);
+  }
+
+  uint8_t mask[4] = {
+    (uint8_t)(maskKey >> 24), (uint8_t)(maskKey >> 16), (uint8_t)(maskKey >> 8), (uint8_t)maskKey
+  };
+  memcpy(out + o, mask, 4);
+  o += 4;
+  for (size_t i = 0; i < len; i++) out[o++] = payload[i] ^ mask[i & 3];
+  return o;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * Incremental WebSocket (RFC 6455) frame decoder and client frame encoder
+ *
+ * Feed the decoder socket bytes in any split. Data frames are reassembled
+ * across continuations into one caller-supplied fixed buffer and reported
+ * when the final fragment arrives; control frames (ping, pong, close; at
+ * most 125 bytes) are collected separately, so they may interleave with a
+ * fragmented message. A message larger than the buffer is skipped whole
+ * and flagged as truncated rather than failing the connection.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WS_CONTROL_MAX_LEN 125
+#define WS_CLIENT_HEADER_MAX 14   // 2 + 8 byte length + 4 byte mask
+
+enum WebSocketOpcode : uint8_t {
+  WS_OP_CONTINUATION = 0x0,
+  WS_OP_TEXT         = 0x1,
+  WS_OP_BINARY       = 0x2,
+  WS_OP_CLOSE        = 0x8,
+  WS_OP_PING         = 0x9,
+  WS_OP_PONG         = 0xA
+};
+
+enum WebSocketEvent : uint8_t {
+  WS_EVENT_NONE,      // Need more bytes
+  WS_EVENT_MESSAGE,   // A complete text/binary message, see message()
+  WS_EVENT_CONTROL,   // A ping/pong/close frame, see control()
+  WS_EVENT_ERROR      // Protocol violation: close the connection
+};
+
+class WebSocketDecoder {
+public:
+  WebSocketDecoder(uint8_t* buffer, size_t capacity);
+
+  void reset();
+
+  /**
+   * Consume bytes up to the end of the next message or control frame.
+   * Returns how many of `len` were used and sets `event`; call again
+   * with the rest. After WS_EVENT_ERROR nothing more is consumed.
+   */
+  size_t feed(const uint8_t* data, size_t len, WebSocketEvent& event);
+
+  // Valid after WS_EVENT_MESSAGE until the next feed()
+  uint8_t messageOpcode() const { return _messageOpcode; }
+  const uint8_t* message() const { return _buffer; }
+  size_t messageLength() const { return _messageLen; }
+  bool messageTruncated() const { return _truncated; }
+
+  // Valid after WS_EVENT_CONTROL until the next feed()
+  uint8_t controlOpcode() const { return _opcode; }
+  const uint8_t* controlPayload() const { return _control; }
+  size_t controlLength() const { return _controlLen; }
+
+  bool failed() const { return _state == FAILED; }
+
+private:
+  enum State {
+    HEADER,        // FIN/RSV/opcode byte
+    LENGTH,        // MASK bit + 7-bit length
+    LENGTH_EXT,    // 16- or 64-bit extended length
+    PAYLOAD,
+    FAILED
+  };
+
+  WebSocketEvent startPayload();
+  WebSocketEvent endFrame();
+
+  uint8_t* _buffer;
+  size_t _capacity;
+  State _state;
+  bool _fin;
+  uint8_t _opcode;
+  uint8_t _extBytes;        // Extended length bytes still to read
+  uint64_t _remaining;      // Payload bytes still to read in this frame
+  bool _inMessage;          // A fragmented data message is open
+  uint8_t _messageOpcode;
+  size_t _messageLen;
+  bool _truncated;
+  uint8_t _control[WS_CONTROL_MAX_LEN];
+  size_t _controlLen;
+};
+
+/**
+ * Write one masked, final client frame into `out` (client frames must be
+ * masked). Returns the frame length, or 0 if `outSize` is too small.
+ */
+size_t webSocketEncodeFrame(uint8_t* out, size_t outSize, uint8_t opcode,
+                            const uint8_t* payload, size_t len, uint32_t maskKey);
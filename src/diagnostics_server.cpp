@@ -0,0 +1,122 @@
+/**
+ * Diagnostics endpoint over esp_http_server
+ *
+ * Every route shares one handler that sets the content type, runs the
+ * route's writer and ends the chunked response. A failed send (client
+ * gone) latches, so the rest of the writer runs without touching the
+ * socket again.
+ */
+
+#include "diagnostics_server.h"
+
+#include <WiFi.h>
+#include <esp_http_server.h>
+#include <ESPmDNS.h>
+#include <stdarg.h>
+
+struct DiagnosticsOutput {
+  httpd_req_t* req;
+  size_t len;
+  bool failed;
+  char buf[DIAGNOSTICS_CHUNK_SIZE];
+};
+
+static httpd_handle_t server = NULL;
+
+static void flushOutput(DiagnosticsOutput& out) {
+  if (out.len == 0 || out.failed) return;
+  if (httpd_resp_send_chunk(out.req, out.buf, out.len) != ESP_OK) out.failed = true;
+  out.len = 0;
+}
+
+void diagPrintf(DiagnosticsOutput& out, const char* format, ...) {
+  if (out.failed) return;
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    size_t room = sizeof(out.buf) - out.len;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out.buf + out.len, room, format, args);
+    va_end(args);
+    if (n < 0) return;
+
+    if ((size_t)n < room) {
+      out.len += n;
+      return;
+    }
+    if (out.len == 0) {  // Larger than the whole buffer: keep what fitted
+      out.len = sizeof(out.buf) - 1;
+      return;
+    }
+    flushOutput(out);  // Retry into the emptied buffer
+    if (out.failed) return;
+  }
+}
+
+static esp_err_t handleRoute(httpd_req_t* req) {
+  const DiagnosticsRoute* route = (const DiagnosticsRoute*)req->user_ctx;
+  httpd_resp_set_type(req, route->contentType);
+  httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+  DiagnosticsOutput out;
+  out.req = req;
+  out.len = 0;
+  out.failed = false;
+  route->write(out);
+  flushOutput(out);
+
+  if (out.failed) return ESP_FAIL;  // Closes the socket
+  return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+bool diagnosticsStart(const char* hostname, const DiagnosticsRoute* routes, size_t routeCount) {
+  if (server != NULL) return true;
+
+  // DiagnosticsOutput lives on the server task's stack
+  static_assert(DIAGNOSTICS_TASK_STACK > DIAGNOSTICS_CHUNK_SIZE + 2048, "Diagnostics task stack too small");
+
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = DIAGNOSTICS_PORT;
+  config.stack_size = DIAGNOSTICS_TASK_STACK;
+  config.max_open_sockets = DIAGNOSTICS_MAX_SOCKETS;
+  config.max_uri_handlers = routeCount;
+  config.lru_purge_enable = true;   // A new scrape evicts a stale connection
+  config.core_id = 0;               // Next to lwIP, off the UI core
+
+  if (httpd_start(&server, &config) != ESP_OK) {
+    Serial.println("[DIAG] HTTP server failed to start");
+    server = NULL;
+    return false;
+  }
+
+  for (size_t i = 0; i < routeCount; i++) {
+    httpd_uri_t uri = {};
+    uri.uri = routes[i].uri;
+    uri.method = HTTP_GET;
+    uri.handler = handleRoute;
+    uri.user_ctx = (void*)&routes[i];
+    httpd_register_uri_handler(server, &uri);
+  }
+
+  if (MDNS.begin(hostname)) {
+    MDNS.addService("http", "tcp", DIAGNOSTICS_PORT);
+    MDNS.addServiceTxt("http", "tcp", "metrics", "/metrics");
+  } else {
+    Serial.println("[DIAG] mDNS responder failed to start");
+  }
+
+  Serial.printf("[DIAG] Serving http://%s.local/ (%s)\n", hostname, WiFi.localIP().toString().c_str());
+  return true;
+}
+
+void diagnosticsStop() {
+  if (server == NULL) return;
+  MDNS.end();
+  httpd_stop(server);
+  server = NULL;
+  Serial.println("[DIAG] Stopped");
+}
+
+bool diagnosticsRunning() {
+  return server != NULL;
+}
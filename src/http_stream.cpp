@@ -0,0 +1,141 @@
+#include "http_stream.h"
+
+HttpBodyStream::HttpBodyStream(TlsSessionClient& client, unsigned long timeoutMs)
+    : _client(client), _chunked(false), _timeoutMs(timeoutMs), _finished(false), _remaining(-1), _pos(0), _len(0) {
+}
+
+bool HttpBodyStream::readHead(HttpResponseHead& head) {
+  httpResetHead(head);
+
+  char line[HTTP_HEADER_LINE_MAX];
+  size_t lineLen = 0;
+  bool truncated = false;
+
+  for (;;) {
+    if (_pos >= _len && !refill()) return false;
+
+    char c = (char)_buf[_pos++];
+    if (c != '\n') {
+      if (lineLen < sizeof(line) - 1) {
+        line[lineLen++] = c;
+      } else {
+        truncated = true;
+      }
+      continue;
+    }
+
+    if (lineLen > 0 && line[lineLen - 1] == '\r') lineLen--;
+    line[lineLen] = '\0';
+    if (!truncated || head.status == 0) {
+      if (!httpParseHeadLine(head, line)) break;
+    }
+    lineLen = 0;
+    truncated = false;
+  }
+
+  // Body bytes that arrived with the head are decoded in place
+  _chunked = head.chunked;
+  if (_chunked && _pos < _len) {
+    _len = _pos + _decoder.decode(_buf + _pos, _len - _pos);
+    if (_decoder.finished() || _decoder.failed()) _finished = true;
+  }
+
+  // Content-Length only bounds an unchunked body; 204/304 never have one
+  if (head.status == 204 || head.status == 304) {
+    _remaining = 0;
+  } else if (!_chunked) {
+    _remaining = head.contentLength;
+  }
+  if (_remaining >= 0) {
+    size_t buffered = _len - _pos;
+    if (buffered > (size_t)_remaining) _len = _pos + _remaining;  // Ignore bytes past the body
+    _remaining -= _len - _pos;
+    if (_remaining == 0) _finished = true;
+  }
+  return head.status > 0;
+}
+
+bool HttpBodyStream::refill() {
+  unsigned long start = millis();
+
+  while (!_finished) {
+    size_t want = sizeof(_buf);
+    if (_remaining >= 0 && want > (size_t)_remaining) want = _remaining;
+
+    int n = _client.read(_buf, want);
+    if (n > 0) {
+      size_t produced = _chunked ? _decoder.decode(_buf, n) : (size_t)n;
+      if (_decoder.finished() || _decoder.failed()) _finished = true;
+      if (_remaining > 0) {
+        _remaining -= n;
+        if (_remaining == 0) _finished = true;
+      }
+      if (produced > 0) {
+        _pos = 0;
+        _len = produced;
+        return true;
+      }
+      continue;  // Framing only, read on
+    }
+
+    if (!_client.connected() && _client.available() == 0) {
+      _finished = true;
+      break;
+    }
+    int32_t remaining = _timeoutMs - (millis() - start);
+    if (remaining <= 0) break;
+    _client.waitReadable(remaining);
+  }
+  return false;
+}
+
+int HttpBodyStream::available() {
+  if (_pos < _len) return _len - _pos;
+  return _finished ? 0 : (_client.available() > 0 ? 1 : 0);
+}
+
+int HttpBodyStream::read() {
+  if (_pos >= _len && !refill()) return -1;
+  return _buf[_pos++];
+}
+
+int HttpBodyStream::peek() {
+  if (_pos >= _len && !refill()) return -1;
+  return _buf[_pos];
+}
+
+size_t HttpBodyStream::readBytes(char* buffer, size_t length) {
+  size_t copied = 0;
+  while (copied < length) {
+    if (_pos >= _len && !refill()) break;
+    size_t n = _len - _pos;
+    if (n > length - copied) n = length - copied;
+    memcpy(buffer + copied, _buf + _pos, n);
+    _pos += n;
+    copied += n;
+  }
+  return copied;
+}
+
+int skipJsonSpace(Stream& stream) {
+  int c = stream.peek();
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+    stream.read();
+    c = stream.peek();
+  }
+  return c;
+}
+
+bool findJsonKey(Stream& stream, const char* key) {
+  char quoted[40];
+  snprintf(quoted, sizeof(quoted), "\"%s\"", key);
+
+  // The same text can appear as a string value; only a following colon makes it a key
+  while (stream.find(quoted)) {
+    if (skipJsonSpace(stream) != ':') continue;
+    stream.read();
+    skipJsonSpace(stream);
+    return true;
+  }
+  return false;
+}
@@ -7,45 +7,223 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
-#include <HTTPUpdate.h>
+#include <HTTPClient.h>
 #include <Update.h>
 #include <TFT_eSPI.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_sleep.h>
+#include <esp_pm.h>
+#include <driver/ledc.h>
+#include <driver/gpio.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_netif.h>
+#include <esp_netif_net_stack.h>
+#include <lwip/tcpip.h>
+#include <lwip/etharp.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include <sys/time.h>
+#include <limits.h>
+#include <atomic>
 #include "secrets.h"
+#include "tls_session_client.h"
+#include "diagnostics_server.h"
+#include "websocket_client.h"
+#include "http_stream.h"
+#include "json_arena.h"
+#include "price_history.h"
+#include "source_health.h"
+#include "spsc_queue.h"
+#include "battery_filter.h"
+#include "refresh_policy.h"
+#include "energy_log.h"
+#include "backoff.h"
+#include "semver.h"
+#include "price_format.h"
+#include "memory_watermark.h"
+#include "glyph_atlas.h"
+#include "firmware_image.h"
+#include "rollout.h"
 
 // ========== FIRMWARE VERSION ==========
 #define FIRMWARE_VERSION "1.3.1"
+constexpr SemanticVersion FIRMWARE_SEMVER = parseSemanticVersion(FIRMWARE_VERSION);
+static_assert(semverWellFormed(FIRMWARE_VERSION), "FIRMWARE_VERSION must be MAJOR.MINOR.PATCH");
 
 // ========== POWER MANAGEMENT ==========
 // NOTE: Device is encased without button access - display always on
 // WiFi disconnects between updates to maximize battery life
 #define CPU_FREQ_MHZ 80                // Run at 80MHz instead of 240MHz (saves ~30mA)
 
+// CPU clock policy
+#define CPU_POLICY_FIXED 0             // CPU_FREQ_MHZ for everything
+#define CPU_POLICY_DFS   1             // esp_pm: CPU_BOOST_FREQ_MHZ during TLS handshakes and parsing,
+                                       // CPU_FREQ_MHZ for idle, display and radio waits
+#define CPU_POLICY CPU_POLICY_DFS
+#define CPU_BOOST_FREQ_MHZ   240
+#define CPU_AUTO_LIGHT_SLEEP 0         // Also light-sleep in idle; needs tickless idle in sdkconfig
+// The minimum stays at 80 MHz: below that APB drops too, and UART/SPI
+// clocks set up by the Arduino core would drift
+
+// Idle strategy between scheduled work (price, firmware, battery deadlines)
+#define SLEEP_MODE_NONE  0             // Legacy delay(100) polling, CPU stays awake
+#define SLEEP_MODE_LIGHT 1             // Timer-wakeup light sleep, backlight stays lit
+#define SLEEP_MODE_DEEP  2             // Deep sleep for long gaps, backlight off while asleep
+#define SLEEP_MODE SLEEP_MODE_LIGHT
+#define MIN_SLEEP_MS 50                // Shorter gaps are not worth a sleep transition
+#define DEEP_SLEEP_MIN_MS 10000        // Deep sleep only pays off for gaps longer than a reboot
+
 // ========== HARDWARE CONFIGURATION ==========
 #define BACKLIGHT_PIN 4
 #define BATTERY_PIN   34  // ADC pin for battery voltage
-#define BACKLIGHT_PWM_CHANNEL 0
+#define BATTERY_ADC_CHANNEL ADC1_CHANNEL_6  // GPIO34
+#define BACKLIGHT_PWM_CHANNEL LEDC_CHANNEL_0
+#define BACKLIGHT_PWM_TIMER   LEDC_TIMER_0
+#define BACKLIGHT_PWM_FREQ    5000
 #define BACKLIGHT_FULL 16              // Very low brightness for maximum battery savings (was 32)
 #define BATTERY_LOW_VOLTAGE 3.5       // Low battery warning threshold (volts)
 #define BATTERY_CRITICAL_VOLTAGE 3.0  // Critical - shutdown to prevent damage (volts)
 #define BATTERY_CHARGING_VOLTAGE 4.3  // Voltage indicating device is plugged in/charging
-#define BATTERY_CHECK_INTERVAL 30000  // Check battery every 30 seconds
+#define BATTERY_LOW_CLEAR_VOLTAGE 3.6       // Hysteresis: LOW clears only above this
+#define BATTERY_CHARGING_CLEAR_VOLTAGE 4.2  // Hysteresis: CHARGING clears only below this
+#define BATTERY_INVALID_VOLTAGE 4.5   // LiPo never reads this high: USB power on the divider
+#define BATTERY_ABSENT_VOLTAGE 0.5    // No battery on the divider
+#define BATTERY_CHECK_INTERVAL 30000  // Sample battery every 30 seconds
+#define BATTERY_OVERSAMPLE 16         // Raw ADC reads averaged per sample
+#define BATTERY_ADC_DEFAULT_VREF 1100 // mV, used when eFuse holds no calibration
+#define BATTERY_EVENT_QUEUE_SIZE 4
 
 // ========== DISPLAY CONFIGURATION ==========
 #define SCREEN_WIDTH  240
 #define SCREEN_HEIGHT 135
 
+#define PRICE_TEXT_MAX        16
+#define PRICE_FONT            6
+#define PRICE_GLYPHS          "0123456789,"  // Kept pre-rasterized in priceGlyphs
+#define STATUS_CORNER_WIDTH   50
+#define STATUS_CORNER_HEIGHT  22
+#define STALE_LABEL_X         4            // Age of a restored price, top left...
+#define STALE_LABEL_Y         (PRICE_PAIR_COUNT > 1 ? 22 : 4)  // ...under the pair label if there is one
+#define STALE_LABEL_WIDTH     64
+#define STALE_LABEL_HEIGHT    10
+
+// Sparkline band below the price (font 6 ends at y = 91)
+#define SPARKLINE_X       10
+#define SPARKLINE_Y       100
+#define SPARKLINE_WIDTH   220
+#define SPARKLINE_HEIGHT  30
+#define SPARKLINE_WINDOW_S 604800  // 7 days; 86400 for a 24h chart
+
 // ========== UPDATE INTERVALS ==========
-#define PRICE_UPDATE_INTERVAL_BASE    21600000 // 6 hours
+// Price refresh adapts to the power source, the cell voltage and recent volatility
+#define PRICE_INTERVAL_PLUGGED_MS     300000   // 5 minutes on USB
+#define PRICE_INTERVAL_BATTERY_MS     21600000 // 6 hours on a healthy cell...
+#define PRICE_INTERVAL_MAX_MS         86400000 // ...stretched up to 24 hours as it runs down
+#define PRICE_INTERVAL_MIN_MS         60000    // Never more often than once a minute
+#define PRICE_STRETCH_FROM_VOLTAGE    3.9      // Stretching starts below this (volts)
+#define PRICE_VOLATILITY_WINDOW_S     21600    // Look back 6 hours for recent moves
+#define PRICE_VOLATILITY_MID_BP       100      // A 1% high-low range halves the interval
+#define PRICE_VOLATILITY_HIGH_BP      300      // A 3% range quarters it
+#define PRICE_INTERVAL_JITTER_MS      10000
 #define FIRMWARE_UPDATE_INTERVAL      86400000 // 24 hours
+#define FIRMWARE_ROLLOUT_SLOTS        24       // Each unit checks in one hourly slot of the day, picked from its MAC
+#define FIRMWARE_MIN_CHECK_GAP_MS     43200000 // A check moved onto its slot still waits at least 12 hours
+
+// ========== WIFI CONFIGURATION ==========
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000     // Targeted BSSID/channel attempt before a full scan
+#define WIFI_CONNECT_TIMEOUT_MS      15000    // Full scan + DHCP
+#define WIFI_LEASE_REUSE_MS          3600000  // Reuse a DHCP address for an hour, then renew...
+#define WIFI_ARP_PROBE_MS            200      // ...and only once nobody answers an ARP probe for it
+// Optional static IP: define WIFI_STATIC_IP, WIFI_STATIC_GATEWAY,
+// WIFI_STATIC_SUBNET and WIFI_STATIC_DNS in secrets.h to skip DHCP entirely
+
+// ========== DIAGNOSTICS ==========
+// On USB power WiFi stays up between jobs and serves JSON and Prometheus
+// metrics at http://<hostname>.local/ (see writeDiagnostics* below)
+#define DIAGNOSTICS_ENABLED         1
+#define DIAGNOSTICS_HOSTNAME_PREFIX "btc-display"  // Plus the last 3 MAC bytes
+#define DIAGNOSTICS_RETRY_MS        60000          // Between attempts to bring it up
+
+// ========== NETWORK WINDOW ==========
+#define NETWORK_LOOKAHEAD_MS 1800000  // Pull tasks due within 30 minutes into an open session
+
+// ========== TASKS ==========
+// Networking runs in its own task on core 0 (next to the WiFi/lwIP tasks);
+// loop() on core 1 owns the display, battery supervision and sleep
+#define NETWORK_TASK_CORE     0
+#define NETWORK_TASK_STACK    8192   // TLS handshake + streaming JSON parse
+#define NETWORK_TASK_PRIORITY 1
+#define UI_EVENT_QUEUE_SIZE   16     // Power of two; holds 15 events
 
 // ========== RETRY CONFIGURATION ==========
 #define MAX_API_RETRIES 3
 #define INITIAL_BACKOFF_MS 5000
 #define MAX_BACKOFF_MS 60000
 
-// ========== BUFFER SIZES ==========
-#define PRICE_BUFFER_SIZE 512
+// ========== PRICE SOURCE ==========
+// Primary pair: tracked by the history/sparkline and listed first in PRICE_PAIRS
+#define PRICE_COIN_ID     "bitcoin"   // CoinGecko asset id
+#define PRICE_VS_CURRENCY "usd"       // CoinGecko quote currency
+#define PRICE_URL_MAX_LEN 192
+#define RATE_LIMIT_BACKOFF_MS 60000   // Minimum pause for a 429 without Retry-After
+#define PAIR_ROTATE_INTERVAL_MS 10000 // Time each pair stays on screen when several are configured
+
+// ========== PRICE STREAM ==========
+// On USB power prices come live from the Coinbase ticker feed instead of
+// polling; needs a coinbaseProduct for every entry in PRICE_PAIRS
+#define PRICE_STREAM_ENABLED         1
+#define PRICE_STREAM_HOST            "ws-feed.exchange.coinbase.com"
+#define PRICE_STREAM_MAX_REDRAWS     2        // Per second; ticks in between are coalesced
+#define PRICE_STREAM_BUFFER_SIZE     1024     // One ticker message is ~400 bytes
+#define PRICE_STREAM_STALL_MS        60000    // Reconnect after this long without a tick
+#define PRICE_STREAM_RETRY_MS        10000    // First reconnect delay, doubling...
+#define PRICE_STREAM_RETRY_MAX_MS    600000   // ...up to 10 minutes
+
+// ========== OTA CONFIGURATION ==========
+#define OTA_JSON_ARENA_SIZE 3072   // Bounded JSON memory for release parsing
+#define OTA_URL_MAX_LEN     256
+#define OTA_NVS_NAMESPACE   "ota"
+#define OTA_RX_BUFFER_SIZE  4096   // Matches the flash sector size Update buffers to
+#define OTA_MAX_ATTEMPTS    5      // Range-resumed retries after a dropped download
+#define OTA_RETRY_DELAY_MS  2000
+#define OTA_STALL_TIMEOUT_MS 15000 // No bytes for this long counts as a drop
+#define OTA_DIGEST_ASSET    "firmware.bin.sha256"  // sha256sum output, if the release has no asset digest
+#define OTA_DIGEST_TEXT_LEN 128
+
+// ========== PRICE HISTORY ==========
+#define HISTORY_NVS_NAMESPACE "history"   // Ring copy that survives power loss and resets
+#define CLOCK_VALID_AFTER     1700000000  // Unix time; anything earlier means the clock was never set
+#define HISTORY_BACKFILL_SPACING_S 3600   // Downsample backfilled points to one per hour
+// Live samples are kept at most this often (~39 min), so the ring spans
+// the sparkline window at any fetch rate and NVS is written as rarely
+#define HISTORY_SAMPLE_SPACING_S   (SPARKLINE_WINDOW_S / PRICE_HISTORY_CAPACITY)
+
+// ========== ENERGY MODEL ==========
+// Estimated supply current per state (datasheet typicals at 80 MHz plus
+// panel and low backlight); measure your board to get real figures
+#define ENERGY_WIFI_MA     130   // Scan/association/DHCP
+#define ENERGY_TLS_MA      110   // Handshake crypto with the radio on
+#define ENERGY_HTTP_MA     100   // Request and wait for the response head
+#define ENERGY_PARSE_MA    100   // Body RX + JSON parse
+#define ENERGY_DRAW_MA     50    // Frame buffer compose + SPI DMA
+#define ENERGY_RADIO_MA    95    // Radio on, between the phases above
+#define ENERGY_AWAKE_MA    30    // CPU on, radio off
+#define ENERGY_SLEEP_UA    1500  // Light/deep sleep, panel and backlight still lit
+#define ENERGY_BOOST_MA    30    // Extra while TLS/parse run at CPU_BOOST_FREQ_MHZ (CPU_POLICY_DFS)
+
+// ========== MEMORY TELEMETRY ==========
+// mbedTLS allocates its 16 KB input record buffer in one piece; below this
+// largest free block (radio off) the next handshake is likely to fail
+#define HEAP_TLS_MIN_BLOCK          24576
+#define HEAP_REBOOT_AFTER_FAILURES  3       // Reboot anyway if fetches keep failing meanwhile
+#define HEAP_REBOOT_MAGIC           0x48454150  // "HEAP", survives esp_restart()
+#define HEAP_REBOOT_HOLDOFF_MS      600000    // Uptime before a defragmenting restart, doubled per
+#define HEAP_REBOOT_HOLDOFF_MAX_MS  86400000  // consecutive one up to a day; a healthy day resets it
 
 // ========== COLOR SCHEME ==========
 #define COLOR_BG       0x0000
@@ -56,207 +234,624 @@
 #define COLOR_ERROR    0xF800
 #define COLOR_WARNING  0xFD20
 
+// Palette indices for the 4-bit frame buffer (see framePalette)
+#define PAL_BG       0
+#define PAL_TEXT     1
+#define PAL_GRID     2
+#define PAL_CHART    3
+#define PAL_ERROR    4
+#define PAL_WARNING  5
+
+#define DMA_BAND_ROWS 8   // Rows expanded to RGB565 per DMA transfer
+
+// All pairs are fetched in one simple/price request (ids and currencies are
+// deduplicated) and the display rotates through them between updates
+struct PricePair {
+  const char* coinId;           // CoinGecko asset id
+  const char* currency;         // CoinGecko quote currency
+  const char* coinbaseProduct;  // Coinbase product, NULL if not listed there
+  const char* krakenPair;       // Kraken pair name as returned in "result"
+  const char* label;            // Shown top-left when more than one pair is configured
+};
+
+static const PricePair PRICE_PAIRS[] = {
+  { PRICE_COIN_ID, PRICE_VS_CURRENCY, "BTC-USD", "XXBTZUSD", "BTC/USD" },
+  // { "bitcoin",  "eur", "BTC-EUR", "XXBTZEUR", "BTC/EUR" },
+  // { "ethereum", "usd", "ETH-USD", "XETHZUSD", "ETH/USD" },
+};
+#define PRICE_PAIR_COUNT (sizeof(PRICE_PAIRS) / sizeof(PRICE_PAIRS[0]))
+
 // ========== GLOBAL OBJECTS ==========
 TFT_eSPI tft = TFT_eSPI();
+TFT_eSprite frame = TFT_eSprite(&tft);
+GlyphAtlas priceGlyphs;  // PRICE_GLYPHS at one bit per pixel (~2 KB DRAM, there is no PSRAM)
+JsonArena<OTA_JSON_ARENA_SIZE> otaJsonArena;
+JsonArena<HISTORY_JSON_ARENA_SIZE> historyJsonArena;
 
 // ========== STATE VARIABLES ==========
-float currentPrice = 0.0;
-unsigned long lastPriceUpdate = 0;
-unsigned long lastFirmwareCheck = 0;
+// RTC_DATA_ATTR state is initialised on power-on but survives deep sleep,
+// so a timer wake resumes the schedule instead of starting over.
+RTC_DATA_ATTR float currentPrice = 0.0;
+RTC_DATA_ATTR PriceHistory priceHistory;  // Zeroed on first boot, see loadPriceHistory()
+RTC_DATA_ATTR bool currentPriceOk = false;
+
+struct PriceQuote {
+  float price;
+  bool ok;                    // Present in the last successful response
+};
+RTC_DATA_ATTR PriceQuote pairQuotes[PRICE_PAIR_COUNT];  // pairQuotes[0] mirrors currentPrice
+RTC_DATA_ATTR uint32_t pairQuotesTime = 0;  // Unix time pairQuotes were fetched, 0 if unknown
+RTC_DATA_ATTR bool priceRestored = false;  // pairQuotes came from NVS and no fetch has succeeded since
+
+// Last good quotes, spilled to NVS next to the history ring
+struct SavedQuotes {
+  uint32_t pairsHash;         // pricePairsHash() of the build that saved them
+  uint32_t time;
+  PriceQuote quotes[PRICE_PAIR_COUNT];
+};
+
+// Interchangeable price backends, tried cheapest-first (see fetchCurrentPrice)
+enum PriceFetchResult { PRICE_FETCH_OK, PRICE_FETCH_FAILED, PRICE_FETCH_RATE_LIMITED };
+struct PriceSource {
+  const char* name;
+  // Fills quotes[] for the pairs it lists; retryAfterMs is set from a 429's Retry-After
+  PriceFetchResult (*fetch)(PriceQuote* quotes, uint32_t& retryAfterMs);
+};
+
+static PriceFetchResult fetchCoinGecko(PriceQuote* quotes, uint32_t& retryAfterMs);
+static PriceFetchResult fetchCoinbase(PriceQuote* quotes, uint32_t& retryAfterMs);
+static PriceFetchResult fetchKraken(PriceQuote* quotes, uint32_t& retryAfterMs);
+
+static const PriceSource priceSources[] = {
+  { "CoinGecko", fetchCoinGecko },  // Whole PRICE_PAIRS table in one request
+  { "Coinbase",  fetchCoinbase },
+  { "Kraken",    fetchKraken },
+};
+#define PRICE_SOURCE_COUNT (sizeof(priceSources) / sizeof(priceSources[0]))
+#define PRICE_SOURCE_COINGECKO 0
+RTC_DATA_ATTR SourceHealth sourceHealth[PRICE_SOURCE_COUNT];
+
+// Network task -> UI events. The network task never touches the display;
+// everything it wants shown goes through this queue.
+enum UiScreen : uint8_t {
+  UI_SCREEN_CONNECTING,
+  UI_SCREEN_CONNECTED,
+  UI_SCREEN_WIFI_FAILED,
+  UI_SCREEN_LOADING,
+  UI_SCREEN_WIFI_ERROR,
+  UI_SCREEN_OTA,
+  UI_SCREEN_OTA_FAILED,
+  UI_SCREEN_OTA_DONE
+};
+
+enum UiEventType : uint8_t {
+  UI_EVENT_SCREEN,        // Full-screen status message
+  UI_EVENT_PRICE,         // Result of a price fetch
+  UI_EVENT_OTA_PROGRESS   // Whole-percent OTA progress
+};
+
+struct UiEvent {
+  UiEventType type;
+  uint8_t screen;                     // UI_EVENT_SCREEN
+  bool ok;                            // UI_EVENT_PRICE: fetch succeeded
+  bool live;                          // UI_EVENT_PRICE: streamed tick, pair rotation carries on
+  uint8_t percent;                    // UI_EVENT_OTA_PROGRESS
+  PriceQuote quotes[PRICE_PAIR_COUNT];
+  char detail[40];                    // Second line, e.g. the OTA error
+};
+
+enum NetworkJob : uint32_t {
+  NET_JOB_BOOT = 1,       // First connect, backfill and price after a cold boot
+  NET_JOB_WINDOW,         // Due network tasks (see runNetworkWindow)
+  NET_JOB_DIAGNOSTICS,    // Bring the diagnostics endpoint up or down with USB power
+  NET_JOB_STREAM          // Live ticker feed until unplugged (see runPriceStream)
+};
+
+SpscQueue<UiEvent, UI_EVENT_QUEUE_SIZE> uiEvents;
+TaskHandle_t uiTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+bool networkBusy = false;               // Written by the UI only: set on start, cleared on networkJobDone
+std::atomic<bool> networkJobDone{false};  // Set by the network task; not queued, so never dropped
+SemaphoreHandle_t historyMutex = NULL;  // priceHistory is written by network, read by UI
+RTC_DATA_ATTR uint8_t displayPair = 0;
+unsigned long lastPairRotation = 0;
+RTC_DATA_ATTR unsigned long lastPriceUpdate = 0;
+RTC_DATA_ATTR unsigned long lastFirmwareCheck = 0;
+RTC_DATA_ATTR uint64_t rtcClockOffsetMs = 0;  // Uptime accumulated before the last deep sleep
 bool wifiConnected = false;
-bool batteryLow = false;
+unsigned long lastDiagnosticsJob = 0;
+RTC_DATA_ATTR bool batteryLow = false;
 bool batteryCritical = false;
 float batteryVoltage = 0.0;
-unsigned long lastBatteryCheck = 0;
+uint16_t batteryMillivolts = 0;
+bool batteryCharging = false;
+volatile unsigned long lastBatterySample = 0;  // Written by the sampler timer
+
+// Battery sampling runs in an esp_timer callback (esp_timer task, core 0);
+// only filtered changes reach loop(), through batteryEvents
+struct BatteryEvent {
+  uint16_t voltageMv;
+  uint8_t level;     // BatteryLevel
+  bool charging;
+};
+
+RTC_DATA_ATTR BatteryFilter batteryFilter = {};  // All-zero is the reset state
+SpscQueue<BatteryEvent, BATTERY_EVENT_QUEUE_SIZE> batteryEvents;
+esp_adc_cal_characteristics_t batteryAdcChars;
+esp_timer_handle_t batteryTimer = NULL;
+
+const BatteryThresholds batteryThresholds = {
+  (uint16_t)(BATTERY_ABSENT_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_CRITICAL_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_LOW_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_LOW_CLEAR_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_CHARGING_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_CHARGING_CLEAR_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_INVALID_VOLTAGE * 1000)
+};
+
+// Frame buffer palette and its byte-swapped copy in the order the panel expects
+const uint16_t framePalette[16] = {
+  COLOR_BG, COLOR_TEXT, COLOR_GRID, COLOR_CHART, COLOR_ERROR, COLOR_WARNING
+};
+uint16_t bandPalette[16];
+uint16_t dmaBands[2][SCREEN_WIDTH * DMA_BAND_ROWS];  // Ping-pong RGB565 bands (internal DRAM)
+
+struct DirtyRect {
+  int16_t x, y, w, h;
+};
+DirtyRect dirty = {};
+
+// What is currently on the panel, so redraws can skip unchanged regions
+struct PriceRegion {
+  bool valid;
+  char text[PRICE_TEXT_MAX];
+  uint8_t font;
+  uint8_t color;
+  int16_t x, y, w, h;
+};
+PriceRegion shownPrice = {};
+
+struct SparklineRegion {
+  bool valid;
+  bool visible;               // Only the primary pair has history
+  uint32_t version;           // priceHistory.version that was drawn
+};
+SparklineRegion shownSparkline = {};
+
+struct PairLabel {
+  bool valid;
+  uint8_t pair;
+};
+PairLabel shownPairLabel = {};
+
+struct StaleLabel {
+  bool valid;
+  char text[AGE_FORMAT_MAX_LEN + 4];  // "3h ago", "STALE" or empty
+};
+StaleLabel shownStale = {};
+
+enum StatusCornerState : uint8_t { STATUS_NONE, STATUS_LOW, STATUS_CHARGING, STATUS_CRITICAL };
+struct StatusCorner {
+  bool valid;
+  uint8_t status;
+  char voltage[8];
+};
+StatusCorner statusCorner = {};
 
 // Plug-in detection (for display only)
-bool isPluggedIn = false;
-bool wasPluggedIn = false;
+RTC_DATA_ATTR bool isPluggedIn = false;
+RTC_DATA_ATTR bool wasPluggedIn = false;
 
 // Rate limiting state
-unsigned long rateLimitBackoffUntil = 0;
-int consecutiveApiFailures = 0;
-
-// Dynamic intervals (to randomize slightly)
-unsigned long PRICE_UPDATE_INTERVAL = PRICE_UPDATE_INTERVAL_BASE;
+RTC_DATA_ATTR int consecutiveApiFailures = 0;
+
+// Last-good association, reused for a targeted fast connect
+struct WifiFastConnectCache {
+  bool valid;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  unsigned long leaseTime;  // uptimeMs() when the address came from DHCP
+};
+RTC_DATA_ATTR WifiFastConnectCache wifiCache = {};
+
+// Work that needs WiFi, batched into shared sessions by runNetworkWindow()
+struct NetworkTask {
+  const char* name;
+  unsigned long (*dueIn)(unsigned long now);  // ms until due, 0 when due
+  void (*run)(unsigned long now);              // Called with WiFi connected
+  void (*finish)(unsigned long now);           // Reschedule, even if WiFi failed
+};
+
+// Price interval inputs the UI cannot read from elsewhere (to randomize slightly)
+RTC_DATA_ATTR unsigned long priceIntervalJitter = 0;
+RTC_DATA_ATTR unsigned long firmwareCheckDelay = FIRMWARE_UPDATE_INTERVAL;  // From lastFirmwareCheck to this unit's slot
+RTC_DATA_ATTR bool firmwareSlotOnWallClock = false;  // False until the slot was aimed with the clock set
+RTC_DATA_ATTR uint32_t recentMoveBp = 0;  // Updated by the network task after each fetch
+
+// Per-phase timing: one timer per task so neither needs a lock
+PhaseTimer networkPhases = {};
+PhaseTimer uiPhases = {};
+RTC_DATA_ATTR EnergyLog energyLog = {};
+RTC_DATA_ATTR unsigned long lastEnergyRecordMs = 0;
+RTC_DATA_ATTR unsigned long energySleepMs = 0;   // Slept since the last record
+
+// ENERGY_BOOST_MA is added to the boosted phases once DFS is running
+EnergyModel energyModel = {
+  { ENERGY_WIFI_MA, ENERGY_TLS_MA, ENERGY_HTTP_MA, ENERGY_PARSE_MA, ENERGY_DRAW_MA, ENERGY_RADIO_MA },
+  ENERGY_AWAKE_MA,
+  ENERGY_SLEEP_UA
+};
+
+const RefreshPolicy priceRefreshPolicy = {
+  PRICE_INTERVAL_PLUGGED_MS,
+  PRICE_INTERVAL_BATTERY_MS,
+  PRICE_INTERVAL_MAX_MS,
+  PRICE_INTERVAL_MIN_MS,
+  (uint16_t)(PRICE_STRETCH_FROM_VOLTAGE * 1000),
+  (uint16_t)(BATTERY_LOW_VOLTAGE * 1000),
+  PRICE_VOLATILITY_MID_BP,
+  PRICE_VOLATILITY_HIGH_BP
+};
 
 // ========== FUNCTION DECLARATIONS ==========
-void connectWifi();
+void connectWifi(bool showProgress = true);
 void disconnectWifi();
-void stripChunkedEncoding(const char* raw, char* output, size_t maxLen);
-bool fetchCurrentPrice(float& out);
+void releaseWifi();
+bool fetchCurrentPrice(PriceQuote* quotes);
 void drawPrice(float price, bool netOk = true);
-String formatPriceWithCommas(float price);
+void drawDisplayedPair();
+void drawPairLabel();
+void drawStaleIndicator();
+void rotateDisplayedPair();
 bool checkForFirmwareUpdate();
-void performFirmwareUpdate(const String& firmwareUrl);
+void loadReleaseValidators(char* etag, size_t etagLen, char* lastModified, size_t lastModifiedLen);
+void saveReleaseValidators(const HttpResponseHead& head);
+bool runningImageDigest(uint8_t* digest);
+void performFirmwareUpdate(const String& firmwareUrl, const uint8_t* expectedDigest);
 int calculateBackoff(int attempt);
+void setupBatteryMonitor();
+void beginPhase(PhaseTimer& timer, uint8_t phase);
+void endPhase(PhaseTimer& timer, uint8_t phase);
+void closeEnergyRecord();
+void setCpuBoost(bool on);
+const char* cpuPolicyName();
+void printEnergyRecord(const WakeEnergy& record);
+void sampleMemory(uint8_t phase);
+void resetMemoryTelemetry();
+void printMemoryStats();
+void checkHeapFragmentation();
+void startDiagnostics();
+void runDiagnosticsJob();
+unsigned long priceStreamDueIn(unsigned long now);
+void scheduleFirmwareCheck(unsigned long now);
+void runPriceStream();
 void checkBattery();
 bool checkIfPluggedIn();
 void drawBatteryWarning();
+void clearScreen();
+void drawSparkline();
+void setClockFromHead(const HttpResponseHead& head);
+bool recordPriceSample(const PriceQuote* quotes);
+bool restoreLastQuotes();
+void loadPriceHistory();
+void savePriceHistory();
+void backfillPriceHistory();
+void startNetworkTasks();
+void startNetworkJob(NetworkJob job);
+void postUiEvent(const UiEvent& event);
+void postScreen(UiScreen screen, const char* detail = "");
+void handleUiEvents();
+void drawStatusScreen(uint8_t screen, const char* detail);
+bool networkWindowDue(unsigned long now);
+unsigned long timeUntilUiDeadline(unsigned long now);
+void setupDisplay();
+void setupGlyphCache();
+void markDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+void flushDisplay();
 void shutdownDevice(const String& reason);
 void configurePowerSaving();
-int compareSemanticVersion(const String& v1, const String& v2);
+void setupBacklight();
+void setBacklight(uint8_t duty);
+unsigned long uptimeMs();
+unsigned long remainingUntil(unsigned long last, unsigned long interval, unsigned long now);
+void runNetworkWindow(unsigned long now);
+unsigned long timeUntilNextDeadline(unsigned long now);
+void sleepUntilNextDeadline(unsigned long now);
+void enterDeepSleep(unsigned long sleepMs);
+bool resumeFromDeepSleep();
 
 // ========== WIFI CONNECTION ==========
-void connectWifi() {
-  Serial.println("\n[WiFi] Connecting to " + String(WIFI_SSID));
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
+#define WIFI_GOT_IP_BIT       BIT0
+#define WIFI_DISCONNECTED_BIT BIT1
+#define WIFI_ASSOCIATED_BIT   BIT2
 
-  tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_TEXT, COLOR_BG);
-  tft.setTextDatum(MC_DATUM);
-  tft.drawString("Connecting WiFi...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+static EventGroupHandle_t wifiEventGroup = NULL;
+static bool wifiUsingDhcp = true;
 
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      xEventGroupSetBits(wifiEventGroup, WIFI_ASSOCIATED_BIT);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      xEventGroupSetBits(wifiEventGroup, WIFI_GOT_IP_BIT);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      xEventGroupSetBits(wifiEventGroup, WIFI_DISCONNECTED_BIT);
+      break;
+    default:
+      break;
   }
+}
 
-  if (WiFi.status() == WL_CONNECTED) {
-    wifiConnected = true;
-    Serial.println("\n[WiFi] Connected!");
-    Serial.println("[WiFi] IP: " + WiFi.localIP().toString());
+/**
+ * Block until `readyBit` is set (the station has an IP address, or has
+ * associated), or the timeout passes. The fast path gives up on the first
+ * disconnect event; the full scan lets the driver keep retrying until the
+ * timeout.
+ */
+static bool waitForWifi(unsigned long timeoutMs, bool failOnDisconnect, EventBits_t readyBit = WIFI_GOT_IP_BIT) {
+  EventBits_t mask = readyBit | (failOnDisconnect ? WIFI_DISCONNECTED_BIT : 0);
+  EventBits_t bits = xEventGroupWaitBits(wifiEventGroup, mask, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+  return (bits & readyBit) != 0;
+}
 
-    tft.fillScreen(COLOR_BG);
-    tft.drawString("WiFi Connected!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
-    delay(1000);
-  } else {
-    wifiConnected = false;
-    Serial.println("\n[WiFi] Connection failed!");
-    tft.fillScreen(COLOR_BG);
-    tft.setTextColor(COLOR_ERROR, COLOR_BG);
-    tft.drawString("WiFi Failed!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
-    delay(2000);
-  }
+static void clearWifiBits() {
+  xEventGroupClearBits(wifiEventGroup, WIFI_GOT_IP_BIT | WIFI_DISCONNECTED_BIT | WIFI_ASSOCIATED_BIT);
 }
 
-void disconnectWifi() {
-  if (wifiConnected) {
-    Serial.println("[WiFi] Disconnecting to save power...");
-    WiFi.disconnect(true);  // true = turn off WiFi radio
-    WiFi.mode(WIFI_OFF);
-    wifiConnected = false;
-    Serial.println("[WiFi] Disconnected");
+#ifndef WIFI_STATIC_IP
+static bool cachedLeaseFresh() {
+  return wifiCache.ip != 0 && uptimeMs() - wifiCache.leaseTime < WIFI_LEASE_REUSE_MS;
+}
+
+static void applyCachedLease() {
+  WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+              IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+}
+#endif
+
+/**
+ * Static IP from secrets.h, else DHCP. A still-fresh cached lease is not
+ * applied here: the station is left in static mode with no address, so it
+ * associates without DHCP and without announcing anything, and
+ * claimCachedLease() decides once the lease has been probed. Returns true
+ * when that probe is pending.
+ */
+static bool applyIpConfig(bool allowCachedLease) {
+#ifdef WIFI_STATIC_IP
+  IPAddress ip, gateway, subnet, dns;
+  ip.fromString(WIFI_STATIC_IP);
+  gateway.fromString(WIFI_STATIC_GATEWAY);
+  subnet.fromString(WIFI_STATIC_SUBNET);
+  dns.fromString(WIFI_STATIC_DNS);
+  WiFi.config(ip, gateway, subnet, dns);
+  wifiUsingDhcp = false;
+  return false;
+#else
+  if (allowCachedLease && cachedLeaseFresh()) {
+    applyCachedLease();  // Stops DHCP and keeps WiFi.begin() from restarting it
+    esp_netif_t* sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t none = {};
+    if (sta != NULL && esp_netif_set_ip_info(sta, &none) == ESP_OK) {
+      wifiUsingDhcp = false;
+      return true;
+    }
   }
+  WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);  // DHCP
+  wifiUsingDhcp = true;
+  return false;
+#endif
 }
 
-// ========== EXPONENTIAL BACKOFF ==========
-int calculateBackoff(int attempt) {
-  if (attempt <= 0) return 0;
+#ifndef WIFI_STATIC_IP
+struct AddressProbe {
+  struct netif* netif;
+  ip4_addr_t ip;
+  SemaphoreHandle_t done;
+  bool answered;
+  err_t err;
+};
 
-  int backoff = INITIAL_BACKOFF_MS * (1 << (attempt - 1)); // Exponential: 5s, 10s, 20s...
-  if (backoff > MAX_BACKOFF_MS) backoff = MAX_BACKOFF_MS;
+/**
+ * lwIP thread. The interface has no address yet, so the request goes out
+ * as an RFC 5227 probe (sender IP 0.0.0.0) and nobody's ARP cache is
+ * touched; the pending entry it leaves is filled in by any reply.
+ */
+static void sendAddressProbe(void* arg) {
+  AddressProbe* probe = (AddressProbe*)arg;
+  probe->err = etharp_query(probe->netif, &probe->ip, NULL);
+  xSemaphoreGive(probe->done);
+}
 
-  // Add jitter (±20%)
-  int jitter = random(-backoff / 5, backoff / 5);
-  return backoff + jitter;
+// lwIP thread: a reply from the address's current holder turned the entry stable
+static void readAddressProbe(void* arg) {
+  AddressProbe* probe = (AddressProbe*)arg;
+  struct eth_addr* mac;
+  const ip4_addr_t* ip;
+  probe->answered = etharp_find_addr(probe->netif, &probe->ip, &mac, &ip) >= 0;
+  etharp_cleanup_netif(probe->netif);  // Drop the probe entry either way
+  xSemaphoreGive(probe->done);
 }
 
-// ========== CHUNKED ENCODING PARSER (optimized, no String allocation) ==========
-void stripChunkedEncoding(const char* raw, char* output, size_t maxLen) {
-  if (!raw || !output || maxLen == 0) return;
+/**
+ * The cached lease is reused without asking the DHCP server, which may
+ * have handed the address to someone else meanwhile. Probe for it and
+ * listen briefly; only silence counts as free.
+ */
+static bool cachedAddressFree() {
+  static SemaphoreHandle_t probeDone = NULL;
+  if (probeDone == NULL) probeDone = xSemaphoreCreateBinary();
+  esp_netif_t* sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  if (sta == NULL || probeDone == NULL) return false;
+
+  AddressProbe probe = { (struct netif*)esp_netif_get_netif_impl(sta), {}, probeDone, false, ERR_OK };
+  ip4_addr_set_u32(&probe.ip, wifiCache.ip);
+  if (probe.netif == NULL || tcpip_callback(sendAddressProbe, &probe) != ERR_OK) return false;
+  xSemaphoreTake(probeDone, portMAX_DELAY);
+  if (probe.err != ERR_OK) return false;
+  vTaskDelay(pdMS_TO_TICKS(WIFI_ARP_PROBE_MS));
+  if (tcpip_callback(readAddressProbe, &probe) != ERR_OK) return false;
+  xSemaphoreTake(probeDone, portMAX_DELAY);
+  return !probe.answered;
+}
 
-  size_t rawLen = strlen(raw);
-  if (rawLen == 0) {
-    output[0] = '\0';
-    return;
+// Associated with no address: apply the cached lease if the probe went unanswered, else DHCP
+static bool claimCachedLease() {
+  clearWifiBits();
+  if (cachedAddressFree()) {
+    applyCachedLease();
+    wifiUsingDhcp = false;
+    return waitForWifi(WIFI_FAST_CONNECT_TIMEOUT_MS, true);
   }
-
-  // Check if this looks like chunked encoding
-  const char* firstLineEnd = strchr(raw, '\n');
-  if (!firstLineEnd) {
-    strncpy(output, raw, maxLen - 1);
-    output[maxLen - 1] = '\0';
-    return;
+  Serial.println("[WiFi] Cached address is taken, requesting a new lease");
+  wifiCache.ip = 0;
+  applyIpConfig(false);  // Starts DHCP on the association we already have
+  return waitForWifi(WIFI_CONNECT_TIMEOUT_MS, true);
+}
+#endif
+
+static void rememberAssociation() {
+  memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+  wifiCache.channel = WiFi.channel();
+  if (wifiUsingDhcp) {
+    wifiCache.ip = (uint32_t)WiFi.localIP();
+    wifiCache.gateway = (uint32_t)WiFi.gatewayIP();
+    wifiCache.subnet = (uint32_t)WiFi.subnetMask();
+    wifiCache.dns = (uint32_t)WiFi.dnsIP();
+    wifiCache.leaseTime = uptimeMs();
   }
+  wifiCache.valid = true;
+}
 
-  // Extract first line
-  char firstLine[32];
-  size_t firstLineLen = firstLineEnd - raw;
-  if (firstLineLen >= sizeof(firstLine)) firstLineLen = sizeof(firstLine) - 1;
-  strncpy(firstLine, raw, firstLineLen);
-  firstLine[firstLineLen] = '\0';
-
-  // Trim and check if it's a hex number
-  char* endPtr;
-  long firstChunkSize = strtol(firstLine, &endPtr, 16);
-  if (endPtr == firstLine || (*endPtr != '\0' && *endPtr != '\r' && *endPtr != ' ')) {
-    // Not chunked encoding, copy as-is
-    strncpy(output, raw, maxLen - 1);
-    output[maxLen - 1] = '\0';
-    return;
+void connectWifi(bool showProgress) {
+  Serial.println("\n[WiFi] Connecting to " + String(WIFI_SSID));
+  if (wifiEventGroup == NULL) {
+    wifiEventGroup = xEventGroupCreate();
+    WiFi.onEvent(onWifiEvent);
   }
+  WiFi.mode(WIFI_STA);
 
-  // Parse chunked encoding
-  size_t pos = 0;
-  size_t outPos = 0;
-
-  while (pos < rawLen && outPos < maxLen - 1) {
-    const char* lineEnd = strchr(raw + pos, '\n');
-    if (!lineEnd) break;
+  if (showProgress) postScreen(UI_SCREEN_CONNECTING);
+  beginPhase(networkPhases, PHASE_WIFI);
 
-    // Extract chunk size line
-    char chunkSizeLine[32];
-    size_t lineLen = lineEnd - (raw + pos);
-    if (lineLen >= sizeof(chunkSizeLine)) lineLen = sizeof(chunkSizeLine) - 1;
-    strncpy(chunkSizeLine, raw + pos, lineLen);
-    chunkSizeLine[lineLen] = '\0';
+  unsigned long start = millis();
+  bool connected = false;
 
-    long chunkSize = strtol(chunkSizeLine, NULL, 16);
-    if (chunkSize == 0) break;
+  // Fast path: known AP and channel, no scan; cached lease skips DHCP
+  if (wifiCache.valid) {
+    bool probeLease = applyIpConfig(true);
+    clearWifiBits();
+    WiFi.begin(WIFI_SSID, WIFI_PASS, wifiCache.channel, wifiCache.bssid);
+    connected = waitForWifi(WIFI_FAST_CONNECT_TIMEOUT_MS, true,
+                            probeLease ? WIFI_ASSOCIATED_BIT : WIFI_GOT_IP_BIT);
 
-    pos = (lineEnd - raw) + 1;
+#ifndef WIFI_STATIC_IP
+    if (connected && probeLease) connected = claimCachedLease();
+#endif
 
-    // Copy chunk data
-    if (pos + chunkSize <= rawLen) {
-      size_t copyLen = chunkSize;
-      if (outPos + copyLen > maxLen - 1) copyLen = maxLen - 1 - outPos;
-      memcpy(output + outPos, raw + pos, copyLen);
-      outPos += copyLen;
-      pos += chunkSize;
-    } else {
-      break;
+    if (!connected) {
+      Serial.println("[WiFi] Fast connect failed, falling back to full scan");
+      wifiCache.valid = false;
+      WiFi.disconnect();
     }
+  }
 
-    // Skip CRLF after chunk
-    if (pos < rawLen && raw[pos] == '\r') pos++;
-    if (pos < rawLen && raw[pos] == '\n') pos++;
+  if (!connected) {
+    applyIpConfig(false);
+    clearWifiBits();
+    WiFi.begin(WIFI_SSID, WIFI_PASS);
+    connected = waitForWifi(WIFI_CONNECT_TIMEOUT_MS, false);
   }
+  endPhase(networkPhases, PHASE_WIFI);
+
+  if (connected) {
+    wifiConnected = true;
+    rememberAssociation();
+    Serial.print("[WiFi] Connected in ");
+    Serial.print(millis() - start);
+    Serial.println("ms");
+    Serial.println("[WiFi] IP: " + WiFi.localIP().toString() + (wifiUsingDhcp ? " (DHCP)" : " (reused)"));
 
-  output[outPos] = '\0';
+    if (showProgress) postScreen(UI_SCREEN_CONNECTED);
+  } else {
+    wifiConnected = false;
+    Serial.println("[WiFi] Connection failed!");
+    if (showProgress) postScreen(UI_SCREEN_WIFI_FAILED);
+  }
 }
 
-// ========== COINGECKO API FETCHERS (optimized with char buffers) ==========
-bool fetchCurrentPrice(float& out) {
-  // Check if we're in rate limit backoff period
-  if (millis() < rateLimitBackoffUntil) {
-    unsigned long remaining = (rateLimitBackoffUntil - millis()) / 1000;
-    Serial.print("[API] Rate limit backoff active, ");
-    Serial.print(remaining);
-    Serial.println("s remaining");
-    return false;
+void disconnectWifi() {
+#if DIAGNOSTICS_ENABLED
+  diagnosticsStop();
+#endif
+  if (wifiConnected) {
+    printTlsStats();
+    printMemoryStats();
+
+    Serial.println("[WiFi] Disconnecting to save power...");
+    WiFi.disconnect(true);  // true = turn off WiFi radio
+    WiFi.mode(WIFI_OFF);
+    wifiConnected = false;
+    Serial.println("[WiFi] Disconnected");
   }
+}
 
-  WiFiClientSecure client;
-  client.setInsecure();  // TODO: Fix certificate chain for CoinGecko
+// End of a network job: on USB power stay online for the diagnostics endpoint
+void releaseWifi() {
+#if DIAGNOSTICS_ENABLED
+  if (isPluggedIn && wifiConnected) {
+    printTlsStats();
+    printMemoryStats();
+    startDiagnostics();
+    return;
+  }
+#endif
+  disconnectWifi();  // Save power
+}
 
-  const char* host = "api.coingecko.com";
-  const int httpsPort = 443;
-  const char* url = "/api/v3/simple/price?ids=bitcoin&vs_currencies=usd";
+// ========== EXPONENTIAL BACKOFF ==========
+// Exponential: 5s, 10s, 20s... capped, with ±20% jitter (see lib/core backoff.h)
+int calculateBackoff(int attempt) {
+  return backoffDelayMs(attempt, INITIAL_BACKOFF_MS, MAX_BACKOFF_MS, esp_random());
+}
 
-  Serial.println("[API] Fetching current price...");
+// ========== PRICE SOURCES (streaming, no payload buffers) ==========
+// Append item to a comma-separated list unless it is already in it
+static void appendUnique(char* list, size_t listLen, const char* item) {
+  size_t itemLen = strlen(item);
+  for (const char* p = list; *p; ) {
+    const char* end = strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    if (len == itemLen && strncmp(p, item, len) == 0) return;
+    if (!end) break;
+    p = end + 1;
+  }
+  if (list[0]) strlcat(list, ",", listLen);
+  strlcat(list, item, listLen);
+}
 
-  if (!client.connect(host, httpsPort)) {
-    Serial.println("[API] Connection failed!");
-    consecutiveApiFailures++;
+/**
+ * Send a GET and read the response head. The body is left on `body`
+ * for a streaming parse; on failure the client is already stopped.
+ */
+static bool httpsGet(TlsSessionClient& client, HttpBodyStream& body, HttpResponseHead& head,
+                     const char* host, const char* path) {
+  beginPhase(networkPhases, PHASE_TLS);
+  bool connected = client.connect(host, 443);
+  endPhase(networkPhases, PHASE_TLS);
+  if (!connected) {
+    Serial.printf("[API] Connection to %s failed!\n", host);
     return false;
   }
 
   // Use char buffer for request
-  char request[256];
+  char request[384];
   snprintf(request, sizeof(request),
            "GET %s HTTP/1.1\r\n"
            "Host: %s\r\n"
@@ -264,611 +859,2729 @@ bool fetchCurrentPrice(float& out) {
            "Accept: application/json\r\n"
            "Accept-Encoding: identity\r\n"
            "Connection: close\r\n\r\n",
-           url, host, FIRMWARE_VERSION);
+           path, host, FIRMWARE_VERSION);
+  beginPhase(networkPhases, PHASE_HTTP);
   client.print(request);
 
-  unsigned long timeout = millis();
-  while (client.available() == 0) {
-    if (millis() - timeout > 5000) {
-      Serial.println("[API] Timeout!");
-      client.stop();
-      consecutiveApiFailures++;
-      return false;
-    }
+  // readHead() blocks in select() until the first byte (or the read timeout)
+  bool headOk = body.readHead(head);
+  endPhase(networkPhases, PHASE_HTTP);
+  if (!headOk) {
+    Serial.println(client.connected() ? "[API] Timeout!" : "[API] Malformed response head!");
+    client.stop();
+    return false;
   }
+  Serial.printf("[API] %s first byte after %ums\n", host, client.lastTimeToFirstByte());
+  setClockFromHead(head);
+  return true;
+}
 
-  // Skip headers
-  while (client.connected()) {
-    String line = client.readStringUntil('\n');
-    if (line == "\r" || line.length() == 0) break;
+// Map a non-200 status to a fetch result, picking up Retry-After on 429/503
+static PriceFetchResult statusResult(const HttpResponseHead& head, uint32_t& retryAfterMs) {
+  if (head.status != 429 && head.status != 503) {
+    Serial.printf("[API] HTTP %d\n", head.status);
+    return PRICE_FETCH_FAILED;
   }
 
-  // Read response into char buffer (no String allocation)
-  char rawPayload[PRICE_BUFFER_SIZE];
-  size_t bytesRead = 0;
+  uint32_t seconds;
+  if (httpRetryAfterSeconds(head, seconds)) {
+    retryAfterMs = seconds * 1000;
+    Serial.printf("[API] ⚠️ Rate limited (HTTP %d), Retry-After %us\n", head.status, seconds);
+  } else {
+    Serial.printf("[API] ⚠️ Rate limited (HTTP %d)\n", head.status);
+  }
+  return PRICE_FETCH_RATE_LIMITED;
+}
 
-  while (client.available() && bytesRead < PRICE_BUFFER_SIZE - 1) {
-    rawPayload[bytesRead++] = client.read();
+// CoinGecko: every pair in one simple/price request
+static PriceFetchResult fetchCoinGecko(PriceQuote* quotes, uint32_t& retryAfterMs) {
+  // "/api/v3/simple/price?ids=bitcoin,ethereum&vs_currencies=usd,eur"
+  char ids[64] = "";
+  char currencies[32] = "";
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    appendUnique(ids, sizeof(ids), PRICE_PAIRS[i].coinId);
+    appendUnique(currencies, sizeof(currencies), PRICE_PAIRS[i].currency);
   }
-  rawPayload[bytesRead] = '\0';
-  client.stop();
+  char url[PRICE_URL_MAX_LEN];
+  snprintf(url, sizeof(url), "/api/v3/simple/price?ids=%s&vs_currencies=%s", ids, currencies);
 
-  // Strip chunked transfer encoding (in-place)
-  char payload[PRICE_BUFFER_SIZE];
-  stripChunkedEncoding(rawPayload, payload, PRICE_BUFFER_SIZE);
+  TlsSessionClient client;
+  client.setInsecure();  // TODO: Fix certificate chain for CoinGecko
+  HttpBodyStream body(client);
+  HttpResponseHead head;
+  if (!httpsGet(client, body, head, "api.coingecko.com", url)) return PRICE_FETCH_FAILED;
+  if (head.status != 200) {
+    client.stop();
+    return statusResult(head, retryAfterMs);
+  }
 
-  // Check for rate limiting
-  if (strstr(payload, "rate limit") != NULL || strstr(payload, "429") != NULL) {
-    Serial.println("[API] ⚠️ Rate limit detected!");
-    rateLimitBackoffUntil = millis() + 60000; // Back off for 60 seconds
-    consecutiveApiFailures++;
-    return false;
+  // Keep only the configured pairs, not the full ids x currencies grid
+  JsonDocument filter;
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    filter[PRICE_PAIRS[i].coinId][PRICE_PAIRS[i].currency] = true;
   }
 
-  DynamicJsonDocument doc(1024);
-  DeserializationError error = deserializeJson(doc, payload);
+  // Parse straight from the socket, de-chunking on the fly
+  JsonDocument doc;
+  beginPhase(networkPhases, PHASE_PARSE);
+  DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+  endPhase(networkPhases, PHASE_PARSE);
+  client.stop();
+
   if (error) {
     Serial.print("[API] JSON parse failed: ");
     Serial.println(error.c_str());
+    return PRICE_FETCH_FAILED;
+  }
+
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    JsonVariant q = doc[PRICE_PAIRS[i].coinId][PRICE_PAIRS[i].currency];
+    quotes[i].ok = q.is<float>();
+    if (quotes[i].ok) quotes[i].price = q.as<float>();
+  }
+  return PRICE_FETCH_OK;
+}
+
+// Coinbase: one spot request per pair, {"data":{"amount":"67012.34",...}}
+static PriceFetchResult fetchCoinbase(PriceQuote* quotes, uint32_t& retryAfterMs) {
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    if (!PRICE_PAIRS[i].coinbaseProduct) continue;
+
+    char url[64];
+    snprintf(url, sizeof(url), "/v2/prices/%s/spot", PRICE_PAIRS[i].coinbaseProduct);
+
+    TlsSessionClient client;
+    client.setInsecure();
+    HttpBodyStream body(client);
+    HttpResponseHead head;
+    if (!httpsGet(client, body, head, "api.coinbase.com", url)) return PRICE_FETCH_FAILED;
+    if (head.status != 200) {
+      client.stop();
+      return statusResult(head, retryAfterMs);
+    }
+
+    JsonDocument filter;
+    filter["data"]["amount"] = true;
+
+    JsonDocument doc;
+    beginPhase(networkPhases, PHASE_PARSE);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    endPhase(networkPhases, PHASE_PARSE);
+    client.stop();
+
+    const char* amount = doc["data"]["amount"];
+    if (error || !amount) return PRICE_FETCH_FAILED;
+    quotes[i].price = atof(amount);
+    quotes[i].ok = quotes[i].price > 0;
+  }
+  return PRICE_FETCH_OK;
+}
+
+// Kraken: one Ticker request per pair, last trade price in result.<pair>.c[0]
+static PriceFetchResult fetchKraken(PriceQuote* quotes, uint32_t& retryAfterMs) {
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    const char* pair = PRICE_PAIRS[i].krakenPair;
+    if (!pair) continue;
+
+    char url[64];
+    snprintf(url, sizeof(url), "/0/public/Ticker?pair=%s", pair);
+
+    TlsSessionClient client;
+    client.setInsecure();
+    HttpBodyStream body(client);
+    HttpResponseHead head;
+    if (!httpsGet(client, body, head, "api.kraken.com", url)) return PRICE_FETCH_FAILED;
+    if (head.status != 200) {
+      client.stop();
+      return statusResult(head, retryAfterMs);
+    }
+
+    JsonDocument filter;
+    filter["error"] = true;
+    filter["result"][pair]["c"] = true;
+
+    JsonDocument doc;
+    beginPhase(networkPhases, PHASE_PARSE);
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    endPhase(networkPhases, PHASE_PARSE);
+    client.stop();
+
+    // Kraken reports throttling in the error array, e.g. "EGeneral:Too many requests"
+    if (doc["error"].size() > 0) {
+      Serial.printf("[API] Kraken error: %s\n", doc["error"][0].as<const char*>());
+      return PRICE_FETCH_FAILED;
+    }
+
+    const char* last = doc["result"][pair]["c"][0];
+    if (error || !last) return PRICE_FETCH_FAILED;
+    quotes[i].price = atof(last);
+    quotes[i].ok = quotes[i].price > 0;
+  }
+  return PRICE_FETCH_OK;
+}
+
+/**
+ * Fetch all pairs from the cheapest healthy source, failing over to the
+ * next one in the same WiFi session. A source only counts as successful
+ * if it delivered the primary pair; failures and rate limits park that
+ * source (see source_health.h) without blocking the others.
+ */
+bool fetchCurrentPrice(PriceQuote* out) {
+  uint8_t order[PRICE_SOURCE_COUNT];
+  size_t candidates = rankSources(sourceHealth, PRICE_SOURCE_COUNT, uptimeMs(), order);
+  if (candidates == 0) {
+    Serial.println("[API] All price sources are backing off");
     consecutiveApiFailures++;
     return false;
   }
 
-  if (doc.containsKey("bitcoin") && doc["bitcoin"].containsKey("usd")) {
-    out = doc["bitcoin"]["usd"].as<float>();
-    Serial.print("[API] Price: $");
-    Serial.println(out, 2);
-    consecutiveApiFailures = 0; // Reset failure counter on success
-    return true;
+  for (size_t k = 0; k < candidates; k++) {
+    const PriceSource& source = priceSources[order[k]];
+    SourceHealth& health = sourceHealth[order[k]];
+
+    PriceQuote quotes[PRICE_PAIR_COUNT] = {};
+    Serial.printf("[API] Fetching price from %s...\n", source.name);
+
+    uint32_t retryAfterMs = 0;
+    unsigned long start = millis();
+    PriceFetchResult result = source.fetch(quotes, retryAfterMs);
+    unsigned long elapsed = millis() - start;
+
+    if (result == PRICE_FETCH_OK && quotes[0].ok) {
+      sourceRecordSuccess(health, elapsed);
+      memcpy(out, quotes, sizeof(quotes));
+
+      Serial.print("[API] Price: $");
+      Serial.print(out[0].price, 2);
+      Serial.printf(" from %s in %lums\n", source.name, elapsed);
+      consecutiveApiFailures = 0; // Reset failure counter on success
+      recordPriceSample(out);
+      return true;
+    }
+
+    if (result == PRICE_FETCH_RATE_LIMITED && retryAfterMs > 0) {
+      sourceRecordRetryAfter(health, uptimeMs(), retryAfterMs);
+    } else {
+      sourceRecordFailure(health, uptimeMs(), result == PRICE_FETCH_RATE_LIMITED ? RATE_LIMIT_BACKOFF_MS : 0);
+    }
+    Serial.printf("[API] %s failed, backing off %lus\n", source.name,
+                  (unsigned long)(health.backoffUntil - uptimeMs()) / 1000);
   }
 
-  Serial.println("[API] Invalid JSON structure!");
   consecutiveApiFailures++;
   return false;
 }
 
-
-// ========== SEMANTIC VERSION COMPARISON ==========
+// ========== PRICE STREAM ==========
 /**
- * Compare two semantic version strings (e.g., "1.2.3" vs "1.10.0")
- * Returns: -1 if v1 < v2, 0 if v1 == v2, 1 if v1 > v2
+ * Live prices on USB power: one TLS WebSocket to the Coinbase ticker
+ * feed, held open by the network task. Frames are decoded into a fixed
+ * buffer and parsed through a JSON arena, so a tick allocates nothing.
+ * Ticks are coalesced to PRICE_STREAM_MAX_REDRAWS price events a second
+ * for the dirty-rect renderer, and the history ring still gets only one
+ * sample per PRICE_INTERVAL_PLUGGED_MS. The job ends when the device is
+ * unplugged (polling takes over), the feed drops or stalls, or another
+ * network task falls due.
  */
-int compareSemanticVersion(const String& v1, const String& v2) {
-  // Parse version components
-  int v1Major = 0, v1Minor = 0, v1Patch = 0;
-  int v2Major = 0, v2Minor = 0, v2Patch = 0;
+uint8_t streamBuffer[PRICE_STREAM_BUFFER_SIZE];
+JsonArena<PRICE_STREAM_JSON_ARENA_SIZE> streamJsonArena;
+int streamFailures = 0;
+unsigned long streamRetryAt = 0;   // Uptime; set by the network task before it goes idle
+
+static bool priceStreamSupported() {
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    if (!PRICE_PAIRS[i].coinbaseProduct) return false;
+  }
+  return true;
+}
 
-  // Parse v1
-  int firstDot = v1.indexOf('.');
-  int secondDot = v1.indexOf('.', firstDot + 1);
-  if (firstDot > 0) {
-    v1Major = v1.substring(0, firstDot).toInt();
-    if (secondDot > firstDot) {
-      v1Minor = v1.substring(firstDot + 1, secondDot).toInt();
-      v1Patch = v1.substring(secondDot + 1).toInt();
-    } else {
-      v1Minor = v1.substring(firstDot + 1).toInt();
-    }
-  } else {
-    v1Major = v1.toInt();
+// Milliseconds until loop() should (re)open the feed; ULONG_MAX while it does not apply
+unsigned long priceStreamDueIn(unsigned long now) {
+  if (!PRICE_STREAM_ENABLED || !isPluggedIn || !priceStreamSupported()) return ULONG_MAX;
+  long wait = (long)(streamRetryAt - now);
+  return wait > 0 ? (unsigned long)wait : 0;
+}
+
+static void priceStreamFailed() {
+  streamFailures++;
+  int32_t delayMs = backoffDelayMs(streamFailures, PRICE_STREAM_RETRY_MS, PRICE_STREAM_RETRY_MAX_MS, esp_random());
+  streamRetryAt = uptimeMs() + delayMs;
+  Serial.printf("[STREAM] Retrying in %lds (failure %d)\n", (long)(delayMs / 1000), streamFailures);
+}
+
+// {"type":"subscribe","product_ids":["BTC-USD",...],"channels":["ticker"]}
+static void buildSubscribeRequest(char* out, size_t len) {
+  strlcpy(out, "{\"type\":\"subscribe\",\"product_ids\":[", len);
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    if (i > 0) strlcat(out, ",", len);
+    strlcat(out, "\"", len);
+    strlcat(out, PRICE_PAIRS[i].coinbaseProduct, len);
+    strlcat(out, "\"", len);
   }
+  strlcat(out, "],\"channels\":[\"ticker\"]}", len);
+}
 
-  // Parse v2
-  firstDot = v2.indexOf('.');
-  secondDot = v2.indexOf('.', firstDot + 1);
-  if (firstDot > 0) {
-    v2Major = v2.substring(0, firstDot).toInt();
-    if (secondDot > firstDot) {
-      v2Minor = v2.substring(firstDot + 1, secondDot).toInt();
-      v2Patch = v2.substring(secondDot + 1).toInt();
-    } else {
-      v2Minor = v2.substring(firstDot + 1).toInt();
+// A ticker message for one of our pairs; subscriptions acks and the like are ignored
+static bool parseTick(const char* message, size_t len, const JsonDocument& filter,
+                      size_t& pair, float& price) {
+  JsonDocument doc(&streamJsonArena);
+  if (deserializeJson(doc, message, len, DeserializationOption::Filter(filter))) return false;
+
+  const char* type = doc["type"] | "";
+  if (strcmp(type, "error") == 0) {
+    Serial.printf("[STREAM] Feed error: %s\n", doc["message"] | "?");
+    return false;
+  }
+  if (strcmp(type, "ticker") != 0) return false;
+
+  const char* product = doc["product_id"] | "";
+  const char* value = doc["price"];
+  if (!value) return false;
+  for (pair = 0; pair < PRICE_PAIR_COUNT; pair++) {
+    if (strcmp(PRICE_PAIRS[pair].coinbaseProduct, product) == 0) break;
+  }
+  price = atof(value);
+  return pair < PRICE_PAIR_COUNT && price > 0;
+}
+
+void runPriceStream() {
+  if (!wifiConnected || !WiFi.isConnected()) {
+    connectWifi(false);
+  }
+  if (!wifiConnected) {
+    priceStreamFailed();
+    return;
+  }
+#if DIAGNOSTICS_ENABLED
+  startDiagnostics();
+#endif
+
+  TlsSessionClient client;
+  client.setInsecure();
+  WebSocketClient feed(client, streamBuffer, sizeof(streamBuffer));
+
+  char subscribe[160];
+  buildSubscribeRequest(subscribe, sizeof(subscribe));
+  beginPhase(networkPhases, PHASE_TLS);
+  bool connected = feed.connect(PRICE_STREAM_HOST, "/");
+  endPhase(networkPhases, PHASE_TLS);
+  if (!connected || !feed.sendText(subscribe)) {
+    Serial.printf("[STREAM] Connection to %s failed\n", PRICE_STREAM_HOST);
+    feed.close();
+    priceStreamFailed();
+    releaseWifi();
+    return;
+  }
+  Serial.printf("[STREAM] Subscribed: %s\n", subscribe);
+
+  JsonDocument filter;
+  filter["type"] = true;
+  filter["product_id"] = true;
+  filter["price"] = true;
+  filter["message"] = true;
+
+  // loop() only changes pairQuotes from our own events, and this job is the only one running
+  PriceQuote quotes[PRICE_PAIR_COUNT];
+  memcpy(quotes, pairQuotes, sizeof(quotes));
+
+  const unsigned long redrawMs = 1000 / PRICE_STREAM_MAX_REDRAWS;
+  unsigned long lastTick = millis();
+  unsigned long lastPost = 0;
+  unsigned long lastSample = 0;
+  uint32_t ticks = 0;
+  bool pending = false;
+  bool failed = false;
+
+  while (isPluggedIn && !networkWindowDue(uptimeMs())) {
+    int32_t waitMs = 1000;
+    if (pending) waitMs = (int32_t)remainingUntil(lastPost, redrawMs, millis());
+
+    WebSocketPoll result = feed.poll(waitMs);
+    if (result == WS_POLL_CLOSED) {
+      Serial.println("[STREAM] Feed closed");
+      failed = true;
+      break;
+    }
+
+    size_t pair;
+    float price;
+    if (result == WS_POLL_MESSAGE &&
+        parseTick(feed.message(), feed.messageLength(), filter, pair, price)) {
+      quotes[pair].price = price;
+      quotes[pair].ok = true;
+      lastTick = millis();
+      ticks++;
+      pending = true;
+    }
+
+    if (millis() - lastTick >= PRICE_STREAM_STALL_MS) {
+      Serial.printf("[STREAM] No tick for %lus\n", (unsigned long)(PRICE_STREAM_STALL_MS / 1000));
+      failed = true;
+      break;
+    }
+
+    // Coalesce: the newest tick per pair goes out at most every redrawMs
+    if (pending && millis() - lastPost >= redrawMs) {
+      UiEvent event = {};
+      event.type = UI_EVENT_PRICE;
+      event.ok = true;
+      event.live = true;
+      memcpy(event.quotes, quotes, sizeof(quotes));
+      postUiEvent(event);
+      pending = false;
+      lastPost = millis();
+
+      // Counts as a fresh price, so the polling task stays idle
+      unsigned long now = uptimeMs();
+      lastPriceUpdate = now;
+      consecutiveApiFailures = 0;
+      // Offered as often as a poll would; the ring keeps one per HISTORY_SAMPLE_SPACING_S
+      if (lastSample == 0 || now - lastSample >= PRICE_INTERVAL_PLUGGED_MS) {
+        if (recordPriceSample(quotes)) {
+          recentMoveBp = historyRecentMoveBp(priceHistory, PRICE_VOLATILITY_WINDOW_S);
+        }
+        lastSample = now;
+      }
     }
+  }
+
+  feed.close();
+  Serial.printf("[STREAM] Closed after %u ticks\n", ticks);
+  if (ticks > 0) streamFailures = 0;
+  if (failed) {
+    priceStreamFailed();
   } else {
-    v2Major = v2.toInt();
+    streamRetryAt = uptimeMs();
+  }
+  releaseWifi();
+}
+
+// ========== FIRMWARE DIGESTS ==========
+/**
+ * SHA-256 of app images as published, i.e. of the whole .bin file. A
+ * release whose digest matches the running image (a re-tagged build) or
+ * the image already in the other OTA slot needs no download.
+ */
+static uint8_t otaRxBuffer[OTA_RX_BUFFER_SIZE];  // One flash sector per Update.write(), also used for hashing
+static mbedtls_sha256_context otaSha;            // Digest of the bytes handed to Update.write() so far
+
+static bool readPartition(void* ctx, uint32_t offset, void* buf, size_t len) {
+  return esp_partition_read((const esp_partition_t*)ctx, offset, buf, len) == ESP_OK;
+}
+
+static bool hashPartitionImage(const esp_partition_t* partition, uint8_t* digest) {
+  uint32_t length;
+  if (partition == NULL || !firmwareImageLength(readPartition, (void*)partition, partition->size, length)) {
+    return false;
   }
 
-  // Compare major version
-  if (v1Major != v2Major) {
-    return (v1Major < v2Major) ? -1 : 1;
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  bool ok = mbedtls_sha256_starts_ret(&sha, 0) == 0;
+  for (uint32_t offset = 0; ok && offset < length; offset += sizeof(otaRxBuffer)) {
+    size_t n = min((size_t)(length - offset), sizeof(otaRxBuffer));
+    ok = esp_partition_read(partition, offset, otaRxBuffer, n) == ESP_OK &&
+         mbedtls_sha256_update_ret(&sha, otaRxBuffer, n) == 0;
   }
+  ok = ok && mbedtls_sha256_finish_ret(&sha, digest) == 0;
+  mbedtls_sha256_free(&sha);
+  return ok;
+}
 
-  // Compare minor version
-  if (v1Minor != v2Minor) {
-    return (v1Minor < v2Minor) ? -1 : 1;
+/**
+ * Digest of the running image. Reading ~1 MB of flash takes about a
+ * second, so it is hashed once per build and cached in NVS under the ELF
+ * SHA-256 the build embeds in the app descriptor.
+ */
+bool runningImageDigest(uint8_t* digest) {
+  const uint8_t* buildId = esp_ota_get_app_description()->app_elf_sha256;
+  uint8_t cachedBuild[SHA256_DIGEST_LEN];
+
+  Preferences prefs;
+  prefs.begin(OTA_NVS_NAMESPACE, false);
+  bool ok = prefs.getBytes("run_build", cachedBuild, sizeof(cachedBuild)) == sizeof(cachedBuild) &&
+            memcmp(cachedBuild, buildId, sizeof(cachedBuild)) == 0 &&
+            prefs.getBytes("run_sha", digest, SHA256_DIGEST_LEN) == SHA256_DIGEST_LEN;
+  if (!ok) {
+    unsigned long started = millis();
+    ok = hashPartitionImage(esp_ota_get_running_partition(), digest);
+    if (ok) {
+      prefs.putBytes("run_build", buildId, SHA256_DIGEST_LEN);
+      prefs.putBytes("run_sha", digest, SHA256_DIGEST_LEN);
+      Serial.printf("[OTA] Hashed running image in %lums\n", millis() - started);
+    }
   }
+  prefs.end();
+  return ok;
+}
+
+// Digest from a sha256sum-style release asset
+static bool fetchPublishedDigest(const char* url, uint8_t* digest) {
+  TlsSessionClient client;
+  client.setInsecure(); // GitHub uses Let's Encrypt
 
-  // Compare patch version
-  if (v1Patch != v2Patch) {
-    return (v1Patch < v2Patch) ? -1 : 1;
+  HTTPClient http;
+  http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+  http.setTimeout(OTA_STALL_TIMEOUT_MS);
+  http.setUserAgent("ESP32-BTC-Display/" FIRMWARE_VERSION);
+  if (!http.begin(client, url)) return false;
+
+  bool ok = false;
+  if (http.GET() == HTTP_CODE_OK) {
+    char text[OTA_DIGEST_TEXT_LEN + 1];
+    int size = http.getSize();
+    size_t want = (size > 0 && size < (int)sizeof(text)) ? size : sizeof(text) - 1;
+    size_t n = http.getStreamPtr()->readBytes(text, want);
+    text[n] = '\0';
+    ok = parseSha256Hex(text, digest);
   }
+  http.end();
+  return ok;
+}
 
-  // Versions are equal
-  return 0;
+/**
+ * Boot the other OTA slot if it already holds the release, e.g. after a
+ * rollback or a USB flash over the newer build. Only returns on a miss.
+ */
+static void bootStagedImage(const uint8_t* expected) {
+  const esp_partition_t* next = esp_ota_get_next_update_partition(NULL);
+  uint8_t staged[SHA256_DIGEST_LEN];
+  if (!hashPartitionImage(next, staged) || memcmp(staged, expected, sizeof(staged)) != 0) return;
+  if (esp_ota_set_boot_partition(next) != ESP_OK) return;
+
+  Serial.printf("[OTA] ✅ Release already in %s, switching without download\n", next->label);
+  postScreen(UI_SCREEN_OTA_DONE);
+  delay(2000);  // Let the UI show it before the reset
+  ESP.restart();
 }
 
 // ========== GITHUB OTA FUNCTIONS ==========
+/**
+ * ETag / Last-Modified of the last release JSON that needed no update.
+ * Validators are tied to the running firmware version so a USB flash of
+ * a different build always re-reads the release.
+ */
+void loadReleaseValidators(char* etag, size_t etagLen, char* lastModified, size_t lastModifiedLen) {
+  etag[0] = '\0';
+  lastModified[0] = '\0';
+
+  Preferences prefs;
+  prefs.begin(OTA_NVS_NAMESPACE, true);
+  if (prefs.getString("version", "") == FIRMWARE_VERSION) {
+    prefs.getString("etag", etag, etagLen);
+    prefs.getString("modified", lastModified, lastModifiedLen);
+  }
+  prefs.end();
+}
+
+void saveReleaseValidators(const HttpResponseHead& head) {
+  if (!head.etag[0] && !head.lastModified[0]) return;
+
+  Preferences prefs;
+  prefs.begin(OTA_NVS_NAMESPACE, false);
+  prefs.putString("version", FIRMWARE_VERSION);
+  prefs.putString("etag", head.etag);
+  prefs.putString("modified", head.lastModified);
+  prefs.end();
+}
+
 bool checkForFirmwareUpdate() {
   Serial.println("\n[OTA] Checking for firmware updates...");
 
-  WiFiClientSecure client;
+  TlsSessionClient client;
   client.setInsecure(); // GitHub uses Let's Encrypt, which can be tricky on ESP32
 
   const char* host = "api.github.com";
   const int httpsPort = 443;
-  const String url = "/repos/" + String(GITHUB_REPO) + "/releases/latest";
 
   if (!client.connect(host, httpsPort)) {
     Serial.println("[OTA] Failed to connect to GitHub API");
     return false;
   }
 
-  client.print(String("GET ") + url + " HTTP/1.1\r\n" +
-               "Host: " + host + "\r\n" +
-               "User-Agent: ESP32-Bitcoin-Display/" + String(FIRMWARE_VERSION) + "\r\n" +
-               "Accept: application/vnd.github.v3+json\r\n" +
-               "Connection: close\r\n\r\n");
-
-  unsigned long timeout = millis();
-  while (client.available() == 0) {
-    if (millis() - timeout > 10000) {
-      Serial.println("[OTA] Timeout!");
-      client.stop();
-      return false;
-    }
+  // Revalidate against the last release we saw; unchanged answers 304 with no body
+  char etag[HTTP_ETAG_MAX_LEN];
+  char lastModified[HTTP_DATE_MAX_LEN];
+  loadReleaseValidators(etag, sizeof(etag), lastModified, sizeof(lastModified));
+
+  // Built on the stack: no String temporaries while TLS holds its buffers
+  char request[512];
+  int len = snprintf(request, sizeof(request),
+                     "GET /repos/%s/releases/latest HTTP/1.1\r\n"
+                     "Host: %s\r\n"
+                     "User-Agent: ESP32-Bitcoin-Display/%s\r\n"
+                     "Accept: application/vnd.github.v3+json\r\n",
+                     GITHUB_REPO, host, FIRMWARE_VERSION);
+  if (etag[0]) {
+    len += snprintf(request + len, sizeof(request) - len, "If-None-Match: %s\r\n", etag);
   }
-
-  // Skip headers
-  while (client.connected()) {
-    String line = client.readStringUntil('\n');
-    if (line == "\r" || line.length() == 0) break;
+  if (lastModified[0] && len < (int)sizeof(request)) {
+    len += snprintf(request + len, sizeof(request) - len, "If-Modified-Since: %s\r\n", lastModified);
   }
-
-  // Read JSON payload
-  String payload = "";
-  payload.reserve(4096);
-  while (client.available()) {
-    payload += (char)client.read();
+  if (len < (int)sizeof(request)) {
+    snprintf(request + len, sizeof(request) - len, "Connection: close\r\n\r\n");
   }
-  client.stop();
+  client.print(request);
 
-  // Parse JSON
-  DynamicJsonDocument doc(8192);
-  DeserializationError error = deserializeJson(doc, payload);
-  if (error) {
-    Serial.println("[OTA] JSON parse failed: " + String(error.c_str()));
+  // readHead() blocks in select() until the first byte (or 10s)
+  HttpBodyStream body(client, 10000);
+  HttpResponseHead head;
+  if (!body.readHead(head)) {
+    Serial.println(client.connected() ? "[OTA] Timeout!" : "[OTA] Malformed response head");
+    client.stop();
     return false;
   }
+  Serial.printf("[OTA] GitHub API first byte after %ums\n", client.lastTimeToFirstByte());
+  setClockFromHead(head);
 
-  String latestVersion = doc["tag_name"].as<String>();
-
-  // Remove 'v' prefix if present (e.g., "v1.0.3" -> "1.0.3")
-  if (latestVersion.startsWith("v") || latestVersion.startsWith("V")) {
-    latestVersion = latestVersion.substring(1);
+  if (head.status == 304) {
+    Serial.println("[OTA] ✅ Release unchanged since last check (304)");
+    client.stop();
+    return false;
   }
-
-  Serial.println("[OTA] Current version: " + String(FIRMWARE_VERSION));
-  Serial.println("[OTA] Latest version: " + latestVersion);
-
-  // Semantic version comparison (handles versions like 1.2.0 vs 1.10.0 correctly)
-  if (latestVersion.length() > 0) {
-    int versionCompare = compareSemanticVersion(String(FIRMWARE_VERSION), latestVersion);
-
-    if (versionCompare < 0) {
-      // Current version is older than latest version
-      Serial.println("[OTA] 🆕 New version available!");
-
-    // Find the firmware.bin asset
-    JsonArray assets = doc["assets"].as<JsonArray>();
-    for (JsonObject asset : assets) {
-      String name = asset["name"].as<String>();
-      if (name == "firmware.bin") {
-        String downloadUrl = asset["browser_download_url"].as<String>();
-        Serial.println("[OTA] Found firmware: " + name);
-        Serial.println("[OTA] URL: " + downloadUrl);
-        performFirmwareUpdate(downloadUrl);
-        return true;
-      }
-    }
-
-      Serial.println("[OTA] ⚠️ No firmware.bin found in release assets!");
-      return false;
-    } else if (versionCompare > 0) {
-      // Current version is newer than latest release (dev build?)
-      Serial.println("[OTA] ℹ️ Current version is newer than latest release (development build?)");
-      return false;
+  if (head.status != 200) {
+    uint32_t retryAfter;
+    if (httpRetryAfterSeconds(head, retryAfter)) {
+      Serial.printf("[OTA] GitHub API returned HTTP %d, Retry-After %us\n", head.status, retryAfter);
     } else {
-      // Versions are equal
-      Serial.println("[OTA] ✅ Firmware is up to date");
-      return false;
+      Serial.printf("[OTA] GitHub API returned HTTP %d\n", head.status);
     }
-  } else {
-    Serial.println("[OTA] ⚠️ Invalid version format from GitHub");
+    client.stop();
     return false;
   }
-}
 
-void performFirmwareUpdate(const String& firmwareUrl) {
-  Serial.println("[OTA] Starting firmware update...");
-  Serial.println("[OTA] URL: " + firmwareUrl);
+  // The release JSON is parsed straight off the socket. GitHub emits
+  // tag_name before assets and the (potentially huge) changelog body last,
+  // so reading stops long before the body arrives.
+  JsonDocument doc(&otaJsonArena);
 
-  // Show update screen
-  tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_WARNING, COLOR_BG);
-  tft.setTextDatum(MC_DATUM);
-  tft.drawString("FIRMWARE UPDATE", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 20, 4);
-  tft.setTextColor(COLOR_TEXT, COLOR_BG);
-  tft.drawString("Downloading...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 10, 2);
-  tft.setTextColor(COLOR_ERROR, COLOR_BG);
-  tft.drawString("DO NOT POWER OFF", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 35, 2);
-
-  WiFiClientSecure client;
-  client.setInsecure(); // GitHub uses Let's Encrypt
+  if (!findJsonKey(body, "tag_name") || deserializeJson(doc, body) || !doc.is<const char*>()) {
+    Serial.println("[OTA] ⚠️ No tag_name in release JSON");
+    client.stop();
+    return false;
+  }
 
-  // Update progress callback
-  httpUpdate.onProgress([](int current, int total) {
-    if (total > 0) {
-      int percent = (current * 100) / total;
-      Serial.printf("[OTA] Progress: %d%%\n", percent);
-
-      // Draw progress bar
-      int barWidth = 200;
-      int barHeight = 10;
-      int barX = (SCREEN_WIDTH - barWidth) / 2;
-      int barY = SCREEN_HEIGHT / 2 + 50;
-
-      tft.drawRect(barX, barY, barWidth, barHeight, COLOR_TEXT);
-      tft.fillRect(barX + 2, barY + 2, (barWidth - 4) * percent / 100, barHeight - 4, COLOR_CHART);
-    }
-  });
-
-  // Perform the update
-  t_httpUpdate_return ret = httpUpdate.update(client, firmwareUrl);
-
-  switch (ret) {
-    case HTTP_UPDATE_FAILED:
-      Serial.printf("[OTA] ❌ Update failed. Error (%d): %s\n",
-                    httpUpdate.getLastError(),
-                    httpUpdate.getLastErrorString().c_str());
-
-      tft.fillScreen(COLOR_BG);
-      tft.setTextColor(COLOR_ERROR, COLOR_BG);
-      tft.drawString("UPDATE FAILED!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 10, 4);
-      tft.setTextColor(COLOR_TEXT, COLOR_BG);
-      tft.drawString(httpUpdate.getLastErrorString(), SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
-      delay(5000);
-      break;
+  // Remove 'v' prefix if present (e.g., "v1.0.3" -> "1.0.3")
+  const char* tag = doc.as<const char*>();
+  if (tag[0] == 'v' || tag[0] == 'V') tag++;
+  char latestVersion[24];
+  strlcpy(latestVersion, tag, sizeof(latestVersion));
+  doc.clear();
 
-    case HTTP_UPDATE_NO_UPDATES:
-      Serial.println("[OTA] ℹ️ No update needed");
-      break;
+  Serial.println("[OTA] Current version: " FIRMWARE_VERSION);
+  Serial.printf("[OTA] Latest version: %s\n", latestVersion);
 
-    case HTTP_UPDATE_OK:
-      Serial.println("[OTA] ✅ Update successful! Rebooting...");
-      tft.fillScreen(COLOR_BG);
-      tft.setTextColor(COLOR_CHART, COLOR_BG);
-      tft.drawString("UPDATE COMPLETE!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 10, 4);
-      tft.drawString("Rebooting...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
-      delay(2000);
-      ESP.restart();
-      break;
+  // Semantic version comparison (handles versions like 1.2.0 vs 1.10.0 correctly)
+  if (latestVersion[0] == '\0') {
+    Serial.println("[OTA] ⚠️ Invalid version format from GitHub");
+    client.stop();
+    return false;
   }
-}
 
-// ========== DISPLAY ==========
-String formatPriceWithCommas(float price) {
-  // Convert price to integer
-  int priceInt = (int)price;
+  int versionCompare = compareSemanticVersion(FIRMWARE_SEMVER, parseSemanticVersion(latestVersion));
+  if (versionCompare > 0) {
+    // Current version is newer than latest release (dev build?)
+    Serial.println("[OTA] ℹ️ Current version is newer than latest release (development build?)");
+    client.stop();
+    saveReleaseValidators(head);
+    return false;
+  } else if (versionCompare == 0) {
+    Serial.println("[OTA] ✅ Firmware is up to date");
+    client.stop();
+    saveReleaseValidators(head);
+    return false;
+  }
 
-  // Convert to string
-  String priceStr = String(priceInt);
-  String result = "";
+  // Current version is older than latest version
+  Serial.println("[OTA] 🆕 New version available!");
+
+  // Walk the assets array one object at a time, keeping only name, URL
+  // and the digest GitHub computes for each upload
+  JsonDocument assetFilter;
+  assetFilter["name"] = true;
+  assetFilter["browser_download_url"] = true;
+  assetFilter["digest"] = true;
+
+  char downloadUrl[OTA_URL_MAX_LEN] = "";
+  char digestUrl[OTA_URL_MAX_LEN] = "";
+  uint8_t publishedDigest[SHA256_DIGEST_LEN];
+  bool hasDigest = false;
+  // Only a fully read array proves there is no firmware.bin worth caching validators for
+  bool assetsRead = findJsonKey(body, "assets") && body.read() == '[';
+  if (assetsRead) {
+    while (skipJsonSpace(body) != ']') {
+      DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(assetFilter));
+      if (error) {
+        Serial.println("[OTA] JSON parse failed: " + String(error.c_str()));
+        assetsRead = false;
+        break;
+      }
 
-  int len = priceStr.length();
-  for (int i = 0; i < len; i++) {
-    if (i > 0 && (len - i) % 3 == 0) {
-      result += ",";
+      if (doc["name"] == "firmware.bin") {
+        strlcpy(downloadUrl, doc["browser_download_url"] | "", sizeof(downloadUrl));
+        hasDigest = parseSha256Hex(doc["digest"] | "", publishedDigest);
+      } else if (doc["name"] == OTA_DIGEST_ASSET) {
+        strlcpy(digestUrl, doc["browser_download_url"] | "", sizeof(digestUrl));
+      }
+      doc.clear();
+      if (downloadUrl[0] && (hasDigest || digestUrl[0])) break;
+
+      // Next element or end of array
+      int sep = skipJsonSpace(body);
+      if (sep == ',') {
+        body.read();
+      } else if (sep != ']') {
+        assetsRead = false;
+        break;
+      }
     }
-    result += priceStr.charAt(i);
   }
 
-  return "$" + result;
-}
-
-void drawPrice(float price, bool netOk) {
-  // Clear screen
-  tft.fillScreen(COLOR_BG);
+  // Done with the API: close before the download so TLS memory is released
+  doc.clear();
+  client.stop();
 
-  if (netOk && price > 0) {
-    tft.setTextColor(COLOR_TEXT, COLOR_BG);
-    String priceWithCommas = formatPriceWithCommas(price);
+  if (downloadUrl[0] == '\0' && !assetsRead) {
+    // Unreadable rather than empty: no validators, so the next check fetches it again
+    Serial.println("[OTA] ⚠️ Could not read release assets");
+    return false;
+  }
+  if (downloadUrl[0] == '\0') {
+    Serial.println("[OTA] ⚠️ No firmware.bin found in release assets!");
+    saveReleaseValidators(head);  // Nothing to install until the release changes
+    return false;
+  }
 
-    // Remove the $ from the formatted price
-    String priceNumbers = priceWithCommas.substring(1);  // Remove leading "$"
+  Serial.println("[OTA] Found firmware: firmware.bin");
+  Serial.println("[OTA] URL: " + String(downloadUrl));
 
-    int centerY = SCREEN_HEIGHT / 2;
+  if (!hasDigest && digestUrl[0]) hasDigest = fetchPublishedDigest(digestUrl, publishedDigest);
 
-    // Draw price numbers centered in font 6
-    tft.setTextDatum(MC_DATUM);  // Middle-center alignment
-    tft.drawString(priceNumbers, SCREEN_WIDTH / 2, centerY, 6);
+  if (hasDigest) {
+    char hex[SHA256_HEX_LEN + 1];
+    formatSha256Hex(publishedDigest, hex);
+    Serial.printf("[OTA] Published SHA-256: %s\n", hex);
 
+    uint8_t running[SHA256_DIGEST_LEN];
+    if (runningImageDigest(running) && memcmp(running, publishedDigest, sizeof(running)) == 0) {
+      Serial.println("[OTA] ✅ Release image is the running firmware, skipping download");
+      saveReleaseValidators(head);
+      return false;
+    }
+    bootStagedImage(publishedDigest);  // Restarts if the other slot already has it
   } else {
-    tft.setTextColor(COLOR_ERROR, COLOR_BG);
-    tft.setTextDatum(MC_DATUM);
-    tft.drawString("NO DATA", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 4);
+    Serial.println("[OTA] ℹ️ No published SHA-256, relying on the image checksum");
   }
 
-  // Draw battery warning if needed
+  performFirmwareUpdate(String(downloadUrl), hasDigest ? publishedDigest : NULL);
+  return true;
+}
+
+/**
+ * Download result of one attempt. A drop after some bytes were written is
+ * resumable; anything the server or flash rejects is not.
+ */
+enum OtaAttemptResult {
+  OTA_ATTEMPT_DONE,
+  OTA_ATTEMPT_DROPPED,
+  OTA_ATTEMPT_FATAL
+};
+
+static int otaPostedPercent = -1;
+static int otaShownFill = 0;
+
+// Only whole-percent steps reach the UI queue
+static void reportOtaProgress(size_t written, size_t total) {
+  int percent = (int)((uint64_t)written * 100 / total);
+  if (percent == otaPostedPercent) return;
+  otaPostedPercent = percent;
+
+  if (percent % 10 == 0) {
+    Serial.printf("[OTA] Progress: %d%%\n", percent);
+  }
+  sampleMemory(MEM_PHASE_OTA);
+
+  UiEvent event = {};
+  event.type = UI_EVENT_OTA_PROGRESS;
+  event.percent = percent;
+  postUiEvent(event);
+}
+
+// UI side: the bar grows by the newly covered strip
+static void drawOtaProgress(int percent) {
+  const int barWidth = 200;
+  const int barHeight = 10;
+  const int barX = (SCREEN_WIDTH - barWidth) / 2;
+  const int barY = SCREEN_HEIGHT / 2 + 50;
+
+  if (otaShownFill == 0) {
+    frame.drawRect(barX, barY, barWidth, barHeight, PAL_TEXT);
+    markDirty(barX, barY, barWidth, barHeight);
+  }
+
+  int fill = (barWidth - 4) * percent / 100;
+  if (fill > otaShownFill) {
+    frame.fillRect(barX + 2 + otaShownFill, barY + 2, fill - otaShownFill, barHeight - 4, PAL_CHART);
+    markDirty(barX + 2 + otaShownFill, barY + 2, fill - otaShownFill, barHeight - 4);
+    otaShownFill = fill;
+  }
+  flushDisplay();
+}
+
+// Parse "bytes <start>-<end>/<total>"; total may be "*" (unknown)
+static bool parseContentRange(const String& value, size_t& start, size_t& total) {
+  if (!value.startsWith("bytes ")) return false;
+  int dash = value.indexOf('-');
+  int slash = value.indexOf('/');
+  if (dash < 0 || slash < dash) return false;
+
+  start = strtoul(value.c_str() + 6, NULL, 10);
+  total = (value.charAt(slash + 1) == '*') ? 0 : strtoul(value.c_str() + slash + 1, NULL, 10);
+  return true;
+}
+
+/**
+ * One GET of the image from the current flash offset. The first attempt
+ * sizes the update partition from Content-Length; later ones ask for the
+ * remainder with a Range header. Each request starts again from the
+ * release URL, so an expired signed CDN redirect is simply re-issued.
+ */
+static OtaAttemptResult downloadFirmwareChunk(const String& firmwareUrl, size_t& total, String& error) {
+  TlsSessionClient client;  // Also resumes sessions with the release CDN after the redirect
+  client.setInsecure(); // GitHub uses Let's Encrypt
+
+  size_t written = Update.progress();
+
+  HTTPClient http;
+  http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+  http.setTimeout(OTA_STALL_TIMEOUT_MS);
+  http.setUserAgent("ESP32-BTC-Display/" FIRMWARE_VERSION);
+  if (!http.begin(client, firmwareUrl)) {
+    error = "Bad firmware URL";
+    return OTA_ATTEMPT_FATAL;
+  }
+
+  const char* headerKeys[] = { "Content-Range" };
+  http.collectHeaders(headerKeys, 1);
+  if (written > 0) {
+    http.addHeader("Range", "bytes=" + String(written) + "-");
+  }
+
+  int code = http.GET();
+  size_t skip = 0;
+
+  if (code == HTTP_CODE_PARTIAL_CONTENT && written > 0) {
+    size_t start = 0;
+    size_t rangeTotal = 0;
+    if (!parseContentRange(http.header("Content-Range"), start, rangeTotal) ||
+        start != written || (rangeTotal != 0 && rangeTotal != total)) {
+      error = "Bad Content-Range";
+      http.end();
+      return OTA_ATTEMPT_FATAL;
+    }
+    Serial.printf("[OTA] Resuming at %u of %u bytes\n", written, total);
+  } else if (code == HTTP_CODE_OK) {
+    int size = http.getSize();
+    if (written == 0) {
+      if (size <= 0) {
+        error = "No Content-Length";
+        http.end();
+        return OTA_ATTEMPT_FATAL;
+      }
+      // An earlier attempt may have opened the update and dropped before its first byte
+      if (Update.isRunning()) Update.abort();
+      total = size;
+      if (!Update.begin(total, U_FLASH)) {
+        error = Update.errorString();
+        http.end();
+        return OTA_ATTEMPT_FATAL;
+      }
+      mbedtls_sha256_starts_ret(&otaSha, 0);
+    } else {
+      // Range ignored - discard what is already in flash
+      Serial.println("[OTA] Server ignored Range, skipping written bytes");
+      skip = written;
+    }
+  } else if (code < 0) {
+    error = http.errorToString(code);
+    http.end();
+    return OTA_ATTEMPT_DROPPED;
+  } else {
+    error = "HTTP " + String(code);
+    http.end();
+    return OTA_ATTEMPT_FATAL;
+  }
+
+  WiFiClient* stream = http.getStreamPtr();
+  unsigned long lastData = millis();
+
+  while (Update.progress() < total) {
+    size_t avail = stream->available();
+    if (avail == 0) {
+      int32_t stallLeft = OTA_STALL_TIMEOUT_MS - (int32_t)(millis() - lastData);
+      if (!stream->connected() || stallLeft <= 0) {
+        error = "Connection lost";
+        http.end();
+        return OTA_ATTEMPT_DROPPED;
+      }
+      client.waitReadable(stallLeft);  // Sleeps in select() while the radio waits
+      continue;
+    }
+
+    size_t want = min(avail, sizeof(otaRxBuffer));
+    if (skip > 0) want = min(want, skip);
+    int n = stream->read(otaRxBuffer, want);
+    if (n <= 0) continue;
+    lastData = millis();
+
+    if (skip > 0) {
+      skip -= n;
+      continue;
+    }
+
+    if (Update.write(otaRxBuffer, n) != (size_t)n) {
+      error = Update.errorString();
+      http.end();
+      return OTA_ATTEMPT_FATAL;
+    }
+    mbedtls_sha256_update_ret(&otaSha, otaRxBuffer, n);  // Skipped bytes were hashed when first written
+    reportOtaProgress(Update.progress(), total);
+  }
+
+  http.end();
+  return OTA_ATTEMPT_DONE;
+}
+
+/**
+ * Resumable OTA download.
+ * Bytes accepted by Update.write() stay in the update partition (or its
+ * sector buffer) across a dropped connection, so each retry continues
+ * from Update.progress() instead of fetching the whole image again.
+ * The SHA-256 is taken over the same bytes as they are written, so a
+ * published digest is checked without reading the partition back.
+ */
+void performFirmwareUpdate(const String& firmwareUrl, const uint8_t* expectedDigest) {
+  Serial.println("[OTA] Starting firmware update...");
+  Serial.println("[OTA] URL: " + firmwareUrl);
+
+  // Show update screen
+  postScreen(UI_SCREEN_OTA);
+  otaPostedPercent = -1;
+
+  size_t total = 0;
+  String error;
+  OtaAttemptResult result = OTA_ATTEMPT_DROPPED;
+  mbedtls_sha256_init(&otaSha);
+
+  for (int attempt = 1; attempt <= OTA_MAX_ATTEMPTS; attempt++) {
+    result = downloadFirmwareChunk(firmwareUrl, total, error);
+    if (result != OTA_ATTEMPT_DROPPED) break;
+
+    Serial.printf("[OTA] Attempt %d/%d dropped at %u bytes: %s\n",
+                  attempt, OTA_MAX_ATTEMPTS, Update.progress(), error.c_str());
+    if (attempt == OTA_MAX_ATTEMPTS) break;
+
+    delay(OTA_RETRY_DELAY_MS);
+    if (WiFi.status() != WL_CONNECTED) {
+      Serial.println("[OTA] Waiting for WiFi...");
+      WiFi.reconnect();
+      waitForWifi(WIFI_CONNECT_TIMEOUT_MS, false);
+    }
+  }
+
+  if (result == OTA_ATTEMPT_DONE) {
+    uint8_t digest[SHA256_DIGEST_LEN];
+    mbedtls_sha256_finish_ret(&otaSha, digest);
+    if (expectedDigest != NULL && memcmp(digest, expectedDigest, sizeof(digest)) != 0) {
+      error = "SHA-256 mismatch";
+      result = OTA_ATTEMPT_FATAL;
+    }
+  }
+  mbedtls_sha256_free(&otaSha);
+
+  if (result == OTA_ATTEMPT_DONE && !Update.end(true)) {
+    error = Update.errorString();
+    result = OTA_ATTEMPT_FATAL;
+  }
+
+  if (result != OTA_ATTEMPT_DONE) {
+    if (Update.isRunning()) Update.abort();
+    Serial.printf("[OTA] ❌ Update failed: %s\n", error.c_str());
+    postScreen(UI_SCREEN_OTA_FAILED, error.c_str());  // Stays up until the next price
+    return;
+  }
+
+  Serial.println("[OTA] ✅ Update successful! Rebooting...");
+  postScreen(UI_SCREEN_OTA_DONE);
+  delay(2000);  // Let the UI show it before the reset
+  ESP.restart();
+}
+
+// ========== PRICE HISTORY ==========
+// Take the wall clock from the server's Date header; it survives deep sleep
+void setClockFromHead(const HttpResponseHead& head) {
+  uint32_t serverTime;
+  if (!httpParseDate(head.date, serverTime)) return;
+
+  struct timeval tv = { (time_t)serverTime, 0 };
+  settimeofday(&tv, NULL);
+}
+
+// FNV-1a over each pair's coin and currency, so a reordered or edited PRICE_PAIRS is noticed
+static uint32_t pricePairsHash() {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    const char* parts[] = { PRICE_PAIRS[i].coinId, "/", PRICE_PAIRS[i].currency, ";" };
+    for (const char* part : parts) {
+      for (const char* c = part; *c; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+      }
+    }
+  }
+  return hash;
+}
+
+/**
+ * The primary pair goes into the ring once per HISTORY_SAMPLE_SPACING_S;
+ * each accepted sample is spilled to NVS together with all quotes for the
+ * next cold boot. Returns true when the ring took the sample.
+ */
+bool recordPriceSample(const PriceQuote* quotes) {
+  time_t now = time(NULL);
+  if (now < CLOCK_VALID_AFTER) {
+    Serial.println("[HISTORY] Clock not set, sample dropped");
+    return false;
+  }
+
+  SavedQuotes saved;
+  saved.pairsHash = pricePairsHash();
+  saved.time = (uint32_t)now;
+  memcpy(saved.quotes, quotes, sizeof(saved.quotes));
+
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  const PriceSample* newest = historyNewest(priceHistory);
+  bool added = (!newest || saved.time >= newest->time + HISTORY_SAMPLE_SPACING_S) &&
+               historyPush(priceHistory, saved.time, (uint32_t)lroundf(quotes[0].price * 100));
+  if (added) {
+    Preferences prefs;
+    prefs.begin(HISTORY_NVS_NAMESPACE, false);
+    prefs.putBytes("ring", &priceHistory, sizeof(priceHistory));
+    prefs.putBytes("quotes", &saved, sizeof(saved));
+    prefs.end();
+  }
+  xSemaphoreGive(historyMutex);
+  return added;
+}
+
+/**
+ * Put the last good quotes back after a power loss or reset, so setup()
+ * can draw them at once (marked stale) while the network task fetches
+ * fresh ones. Ignored if PRICE_PAIRS changed since they were saved.
+ */
+bool restoreLastQuotes() {
+  SavedQuotes saved;
+  Preferences prefs;
+  prefs.begin(HISTORY_NVS_NAMESPACE, true);
+  bool loaded = prefs.getBytesLength("quotes") == sizeof(saved) &&
+                prefs.getBytes("quotes", &saved, sizeof(saved)) == sizeof(saved) &&
+                saved.pairsHash == pricePairsHash() && saved.quotes[0].ok;
+  prefs.end();
+  if (!loaded) return false;
+
+  // currentPriceOk stays false: only a fetch makes the price good
+  memcpy(pairQuotes, saved.quotes, sizeof(pairQuotes));
+  currentPrice = pairQuotes[0].price;
+  pairQuotesTime = saved.time;
+  priceRestored = true;
+  return true;
+}
+
+/**
+ * The RTC copy survives deep sleep; after a power loss, reset or a
+ * firmware update it is reloaded from NVS, and started afresh if the
+ * stored layout does not match this build.
+ */
+void loadPriceHistory() {
+  if (historyValid(priceHistory)) return;
+
+  Preferences prefs;
+  prefs.begin(HISTORY_NVS_NAMESPACE, true);
+  bool loaded = prefs.getBytesLength("ring") == sizeof(priceHistory) &&
+                prefs.getBytes("ring", &priceHistory, sizeof(priceHistory)) == sizeof(priceHistory) &&
+                historyValid(priceHistory) && priceHistory.window == SPARKLINE_WINDOW_S;
+  prefs.end();
+
+  if (!loaded) historyReset(priceHistory, SPARKLINE_WINDOW_S);
+  Serial.printf("[HISTORY] %u samples %s\n", priceHistory.count, loaded ? "restored from NVS" : "(new)");
+}
+
+/**
+ * One-shot backfill after boot from /coins/{id}/market_chart.
+ * Only the days since the newest sample are requested (the whole window
+ * if the clock is unknown after a power loss); points the ring already
+ * covers are rejected by historyPush(). The "prices" array is read one
+ * pair at a time and reading stops before market_caps/total_volumes.
+ */
+void backfillPriceHistory() {
+  // Only the network task writes the ring, so reading it here needs no lock
+  const PriceSample* newest = historyNewest(priceHistory);
+  time_t now = time(NULL);
+  uint32_t days = SPARKLINE_WINDOW_S / 86400;
+
+  if (newest && now >= CLOCK_VALID_AFTER) {
+    uint32_t gap = (uint32_t)now > newest->time ? (uint32_t)now - newest->time : 0;
+    if (gap < HISTORY_BACKFILL_SPACING_S) return;
+    days = min(days, gap / 86400 + 1);
+  }
+  if (!sourceAvailable(sourceHealth[PRICE_SOURCE_COINGECKO], uptimeMs())) return;
+
+  TlsSessionClient client;
+  client.setInsecure();
+
+  const char* host = "api.coingecko.com";
+  if (!client.connect(host, 443)) {
+    Serial.println("[HISTORY] Connection failed");
+    return;
+  }
+
+  char request[256];
+  snprintf(request, sizeof(request),
+           "GET /api/v3/coins/" PRICE_COIN_ID "/market_chart?vs_currency=" PRICE_VS_CURRENCY "&days=%u HTTP/1.1\r\n"
+           "Host: %s\r\n"
+           "User-Agent: ESP32-Bitcoin-Display/%s\r\n"
+           "Accept: application/json\r\n"
+           "Accept-Encoding: identity\r\n"
+           "Connection: close\r\n\r\n",
+           days, host, FIRMWARE_VERSION);
+  client.print(request);
+
+  HttpBodyStream body(client, 10000);
+  HttpResponseHead head;
+  if (!body.readHead(head) || head.status != 200) {
+    Serial.printf("[HISTORY] Backfill request failed (HTTP %d)\n", head.status);
+    uint32_t retryAfter;
+    if (head.status == 429 && httpRetryAfterSeconds(head, retryAfter)) {
+      sourceRecordRetryAfter(sourceHealth[PRICE_SOURCE_COINGECKO], uptimeMs(), retryAfter * 1000);
+    }
+    client.stop();
+    return;
+  }
+  setClockFromHead(head);
+
+  JsonDocument point(&historyJsonArena);
+  uint32_t lastKept = newest ? newest->time : 0;
+  size_t added = 0;
+
+  if (findJsonKey(body, "prices") && body.read() == '[') {
+    while (skipJsonSpace(body) != ']') {
+      if (deserializeJson(point, body) || point.size() < 2) break;
+
+      uint32_t t = (uint32_t)(point[0].as<double>() / 1000);
+      float price = point[1].as<float>();
+      point.clear();
+
+      xSemaphoreTake(historyMutex, portMAX_DELAY);
+      if (t >= lastKept + HISTORY_BACKFILL_SPACING_S &&
+          historyPush(priceHistory, t, (uint32_t)lroundf(price * 100))) {
+        lastKept = t;
+        added++;
+      }
+      xSemaphoreGive(historyMutex);
+
+      // Next element or end of array
+      int sep = skipJsonSpace(body);
+      if (sep == ',') {
+        body.read();
+      } else if (sep != ']') {
+        break;
+      }
+    }
+  }
+  client.stop();
+
+  Serial.printf("[HISTORY] Backfilled %u samples (%u days requested)\n", added, days);
+  if (added > 0) {
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    savePriceHistory();
+    xSemaphoreGive(historyMutex);
+  }
+}
+
+// 2 KB blob, at most once per HISTORY_SAMPLE_SPACING_S plus after a backfill. Caller holds historyMutex.
+void savePriceHistory() {
+  Preferences prefs;
+  prefs.begin(HISTORY_NVS_NAMESPACE, false);
+  prefs.putBytes("ring", &priceHistory, sizeof(priceHistory));
+  prefs.end();
+}
+
+// ========== DISPLAY ==========
+/**
+ * Rasterize the price digits once. Each is drawn into the (still blank)
+ * frame from the RLE font and its cell captured at one bit per pixel, so
+ * a redraw is a straight nibble fill from the atlas.
+ */
+void setupGlyphCache() {
+  int16_t h = frame.fontHeight(PRICE_FONT);
+  glyphAtlasReset(priceGlyphs, h);
+  frame.setTextColor(PAL_TEXT, PAL_BG);
+
+  char glyph[2] = { 0, 0 };
+  for (const char* c = PRICE_GLYPHS; *c; c++) {
+    glyph[0] = *c;
+    int16_t w = frame.textWidth(glyph, PRICE_FONT);
+    frame.fillRect(0, 0, w, h, PAL_BG);
+    frame.drawChar(*c, 0, 0, PRICE_FONT);
+    if (!glyphAtlasCapture(priceGlyphs, *c, (const uint8_t*)frame.getPointer(), SCREEN_WIDTH,
+                           SCREEN_HEIGHT, 0, 0, w, PAL_TEXT)) {
+      Serial.printf("[DISPLAY] Glyph '%c' not cached, drawn from the font\n", *c);
+    }
+  }
+  frame.fillRect(0, 0, SCREEN_WIDTH, h, PAL_BG);
+}
+
+static int16_t priceGlyphWidth(char c, uint8_t font) {
+  const GlyphInfo* g = (font == PRICE_FONT) ? glyphAtlasFind(priceGlyphs, c) : NULL;
+  if (g) return g->width;
+
+  char glyph[2] = { c, 0 };
+  return frame.textWidth(glyph, font);
+}
+
+// One glyph with its background, from the atlas when it has it
+static void drawPriceGlyph(char c, int16_t x, int16_t y, uint8_t font, uint8_t color) {
+  const GlyphInfo* g = (font == PRICE_FONT) ? glyphAtlasFind(priceGlyphs, c) : NULL;
+  if (g) {
+    glyphAtlasDraw(priceGlyphs, *g, (uint8_t*)frame.getPointer(), SCREEN_WIDTH, SCREEN_HEIGHT,
+                   x, y, color, PAL_BG);
+  } else {
+    frame.drawChar(c, x, y, font);
+  }
+}
+
+/**
+ * Dirty-rectangle price renderer.
+ * When the layout is unchanged only the digits that differ are redrawn,
+ * each glyph painting its own background; otherwise the new string is
+ * drawn padded to cover the old one. The panel is only cleared after
+ * another screen (WiFi status, OTA) has invalidated it.
+ */
+void drawPrice(float price, bool netOk) {
+  char text[PRICE_TEXT_MAX];
+  uint8_t font;
+  uint8_t color;
+
+  if (netOk && price > 0) {
+    formatGroupedInteger(text, sizeof(text), (uint32_t)price);  // "67,012", no "$"
+    font = PRICE_FONT;
+    color = PAL_TEXT;
+  } else {
+    strlcpy(text, "NO DATA", sizeof(text));
+    font = 4;
+    color = PAL_ERROR;
+  }
+
+  int16_t w = frame.textWidth(text, font);
+  int16_t h = frame.fontHeight(font);
+  int16_t x = (SCREEN_WIDTH - w) / 2;
+  int16_t y = (SCREEN_HEIGHT - h) / 2;
+
+  frame.setTextColor(color, PAL_BG);
+  frame.setTextDatum(TL_DATUM);
+
+  if (!shownPrice.valid) {
+    frame.fillSprite(PAL_BG);
+    markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    statusCorner.valid = false;
+    shownStale.valid = false;
+  }
+
+  bool sameLayout = shownPrice.valid && shownPrice.font == font && shownPrice.color == color &&
+                    shownPrice.x == x && shownPrice.w == w && strlen(shownPrice.text) == strlen(text);
+
+  if (sameLayout) {
+    // Same glyph positions: rewrite only the characters that changed
+    int16_t cx = x;
+    int16_t dirtyLeft = x + w;
+    int16_t dirtyRight = x;
+    for (size_t i = 0; text[i]; i++) {
+      int16_t cw = priceGlyphWidth(text[i], font);
+      if (text[i] != shownPrice.text[i]) {
+        drawPriceGlyph(text[i], cx, y, font, color);
+        dirtyLeft = min(dirtyLeft, cx);
+        dirtyRight = max(dirtyRight, (int16_t)(cx + cw));
+      }
+      cx += cw;
+    }
+    if (dirtyRight > dirtyLeft) markDirty(dirtyLeft, y, dirtyRight - dirtyLeft, h);
+  } else {
+    // Layout changed: clear what the new string will not cover, then draw it
+    if (shownPrice.valid && (shownPrice.font != font || shownPrice.x < x || shownPrice.w > w)) {
+      frame.fillRect(shownPrice.x, shownPrice.y, shownPrice.w, shownPrice.h, PAL_BG);
+      markDirty(shownPrice.x, shownPrice.y, shownPrice.w, shownPrice.h);
+    }
+    int16_t cx = x;
+    for (size_t i = 0; text[i]; i++) {
+      drawPriceGlyph(text[i], cx, y, font, color);
+      cx += priceGlyphWidth(text[i], font);
+    }
+    markDirty(x, y, w, h);
+  }
+
+  strlcpy(shownPrice.text, text, sizeof(shownPrice.text));
+  shownPrice.font = font;
+  shownPrice.color = color;
+  shownPrice.x = x;
+  shownPrice.y = y;
+  shownPrice.w = w;
+  shownPrice.h = h;
+  shownPrice.valid = true;
+  flushDisplay();
+
+  drawPairLabel();
+  drawStaleIndicator();
+  drawSparkline();
+
+  // Draw battery warning if needed
   drawBatteryWarning();
 }
 
-// ========== MAIN ==========
-void setup() {
-  Serial.begin(115200);
-  Serial.print("\n\n=== Bitcoin Live Display v");
-  Serial.print(FIRMWARE_VERSION);
-  Serial.println(" ===");
-  Serial.println("=== BATTERY OPTIMIZED MODE (Low backlight + WiFi power cycling) ===");
+// Full-screen draws (status screens, OTA) invalidate the tracked regions
+void clearScreen() {
+  frame.fillSprite(PAL_BG);
+  markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+  shownPrice.valid = false;
+  shownSparkline.valid = false;
+  shownPairLabel.valid = false;
+  shownStale.valid = false;
+  statusCorner.valid = false;
+}
+
+// Quotes from the last fetch; a failed fetch shows NO DATA for every pair
+// unless the quotes are a restored copy, which stay up with their age
+void drawDisplayedPair() {
+  if (displayPair >= PRICE_PAIR_COUNT) displayPair = 0;
+  const PriceQuote& q = pairQuotes[displayPair];
+  drawPrice(q.price, (currentPriceOk || priceRestored) && q.ok);
+}
+
+void rotateDisplayedPair() {
+  displayPair = (displayPair + 1) % PRICE_PAIR_COUNT;
+  drawDisplayedPair();
+}
+
+// Pair name in the top-left corner, only with more than one pair configured
+void drawPairLabel() {
+  if (PRICE_PAIR_COUNT < 2) return;
+  if (shownPairLabel.valid && shownPairLabel.pair == displayPair) return;
+  shownPairLabel.valid = true;
+  shownPairLabel.pair = displayPair;
+
+  frame.setTextColor(PAL_TEXT, PAL_BG);
+  frame.setTextDatum(TL_DATUM);
+  frame.setTextPadding(80);
+  frame.drawString(PRICE_PAIRS[displayPair].label, 4, 4, 2);
+  frame.setTextPadding(0);
+  markDirty(0, 0, 84, 20);
+  flushDisplay();
+}
+
+/**
+ * Age of a restored price until a fetch replaces it ("STALE" while the
+ * clock is unknown). Only repainted when the text changes.
+ */
+void drawStaleIndicator() {
+  char text[sizeof(shownStale.text)] = "";
+  if (priceRestored && shownPrice.valid && shownPrice.font == PRICE_FONT) {
+    time_t now = time(NULL);
+    if (now >= CLOCK_VALID_AFTER && pairQuotesTime != 0 && (uint32_t)now >= pairQuotesTime) {
+      char age[AGE_FORMAT_MAX_LEN];
+      formatAge(age, sizeof(age), (uint32_t)now - pairQuotesTime);
+      snprintf(text, sizeof(text), "%s ago", age);
+    } else {
+      strlcpy(text, "STALE", sizeof(text));
+    }
+  }
+  // Nothing to erase after a clear: status screens keep the corner
+  if (shownStale.valid ? strcmp(text, shownStale.text) == 0 : text[0] == '\0') return;
+
+  frame.fillRect(STALE_LABEL_X, STALE_LABEL_Y, STALE_LABEL_WIDTH, STALE_LABEL_HEIGHT, PAL_BG);
+  if (text[0]) {
+    frame.setTextColor(PAL_WARNING, PAL_BG);
+    frame.setTextDatum(TL_DATUM);
+    frame.drawString(text, STALE_LABEL_X, STALE_LABEL_Y + 1, 1);
+  }
+  markDirty(STALE_LABEL_X, STALE_LABEL_Y, STALE_LABEL_WIDTH, STALE_LABEL_HEIGHT);
+  flushDisplay();
+
+  strlcpy(shownStale.text, text, sizeof(shownStale.text));
+  shownStale.valid = true;
+}
+
+/**
+ * Sparkline of the history window, scaled to its min/max.
+ * Only repainted when the ring has changed since the last draw; the band
+ * is left empty while a secondary pair is shown.
+ */
+static void drawSparklineLocked() {
+  bool visible = displayPair == 0;
+  if (shownSparkline.valid && shownSparkline.visible == visible &&
+      (!visible || shownSparkline.version == priceHistory.version)) {
+    return;
+  }
+  shownSparkline.valid = true;
+  shownSparkline.visible = visible;
+  shownSparkline.version = priceHistory.version;
+
+  frame.fillRect(SPARKLINE_X, SPARKLINE_Y, SPARKLINE_WIDTH, SPARKLINE_HEIGHT, PAL_BG);
+  markDirty(SPARKLINE_X, SPARKLINE_Y, SPARKLINE_WIDTH, SPARKLINE_HEIGHT);
+
+  uint32_t minCents, maxCents;
+  size_t first = historyWindowStart(priceHistory);
+  if (!visible || priceHistory.count - first < 2 || !historyRange(priceHistory, minCents, maxCents)) {
+    flushDisplay();
+    return;
+  }
+
+  // Dotted midline as a reference
+  int16_t midY = SPARKLINE_Y + SPARKLINE_HEIGHT / 2;
+  for (int16_t x = SPARKLINE_X; x < SPARKLINE_X + SPARKLINE_WIDTH; x += 4) {
+    frame.drawPixel(x, midY, PAL_GRID);
+  }
+
+  uint32_t t0 = historyAt(priceHistory, first).time;
+  uint32_t span = historyNewest(priceHistory)->time - t0;
+  uint32_t range = maxCents - minCents;
+
+  int16_t prevX = 0, prevY = 0;
+  for (size_t i = first; i < priceHistory.count; i++) {
+    const PriceSample& s = historyAt(priceHistory, i);
+    int16_t x = SPARKLINE_X + (int16_t)((uint64_t)(s.time - t0) * (SPARKLINE_WIDTH - 1) / span);
+    int16_t y = range ? SPARKLINE_Y + SPARKLINE_HEIGHT - 1 -
+                        (int16_t)((uint64_t)(s.cents - minCents) * (SPARKLINE_HEIGHT - 1) / range)
+                      : midY;
+    if (i > first) frame.drawLine(prevX, prevY, x, y, PAL_CHART);
+    prevX = x;
+    prevY = y;
+  }
+  flushDisplay();
+}
+
+// The network task may be pushing into the ring meanwhile
+void drawSparkline() {
+  xSemaphoreTake(historyMutex, portMAX_DELAY);
+  drawSparklineLocked();
+  xSemaphoreGive(historyMutex);
+}
+
+// ========== FRAME BUFFER ==========
+/**
+ * Screens are composed in a 4-bit paletted sprite (16 KB instead of 64 KB
+ * for RGB565) and only the dirty rectangle is sent. It is expanded to
+ * RGB565 one band at a time into two DMA buffers, so within a flush each
+ * band is converted while the previous one is on the wire. flushDisplay()
+ * returns only once the last band is out (dmaWait() blocks the task, so
+ * the core idles); the next frame's drawing does not overlap the transfer.
+ */
+void setupDisplay() {
+  tft.init();
+  tft.setRotation(1);
+  tft.initDMA();
+
+  frame.setColorDepth(4);
+  frame.createSprite(SCREEN_WIDTH, SCREEN_HEIGHT);
+  frame.createPalette(framePalette, 16);
+
+  for (int i = 0; i < 16; i++) {
+    bandPalette[i] = (framePalette[i] >> 8) | (framePalette[i] << 8);
+  }
+  setupGlyphCache();
+  clearScreen();
+}
+
+void markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (w <= 0 || h <= 0) return;
+  if (dirty.w <= 0 || dirty.h <= 0) {
+    dirty = { x, y, w, h };
+    return;
+  }
+  int16_t x1 = max((int16_t)(dirty.x + dirty.w), (int16_t)(x + w));
+  int16_t y1 = max((int16_t)(dirty.y + dirty.h), (int16_t)(y + h));
+  dirty.x = min(dirty.x, x);
+  dirty.y = min(dirty.y, y);
+  dirty.w = x1 - dirty.x;
+  dirty.h = y1 - dirty.y;
+}
+
+void flushDisplay() {
+  // Clip, and align to pixel pairs so every source byte expands to two pixels
+  int16_t x0 = max((int16_t)0, dirty.x) & ~1;
+  int16_t y0 = max((int16_t)0, dirty.y);
+  int16_t x1 = min((int16_t)SCREEN_WIDTH, (int16_t)(dirty.x + dirty.w));
+  int16_t y1 = min((int16_t)SCREEN_HEIGHT, (int16_t)(dirty.y + dirty.h));
+  if (x1 & 1) x1++;
+  dirty = {};
+  if (x1 <= x0 || y1 <= y0) return;
+
+  const uint8_t* src = (const uint8_t*)frame.getPointer();
+  int16_t w = x1 - x0;
+  uint8_t band = 0;
+
+  tft.startWrite();
+  for (int16_t y = y0; y < y1; y += DMA_BAND_ROWS) {
+    int16_t rows = min((int16_t)DMA_BAND_ROWS, (int16_t)(y1 - y));
+    uint16_t* out = dmaBands[band];
+
+    for (int16_t r = 0; r < rows; r++) {
+      const uint8_t* line = src + ((y + r) * SCREEN_WIDTH + x0) / 2;
+      for (int16_t i = 0; i < w / 2; i++) {
+        *out++ = bandPalette[line[i] >> 4];
+        *out++ = bandPalette[line[i] & 0x0F];
+      }
+    }
+
+    // Waits for the previous band, then returns while this one transfers
+    tft.pushImageDMA(x0, y, w, rows, dmaBands[band]);
+    band ^= 1;
+  }
+  tft.dmaWait();  // Callers draw into the frame next, so the push has to be done
+  tft.endWrite();
+}
+
+// ========== MAIN ==========
+void setup() {
+  Serial.begin(115200);
+  Serial.print("\n\n=== Bitcoin Live Display v");
+  Serial.print(FIRMWARE_VERSION);
+  Serial.println(" ===");
+  Serial.println("=== BATTERY OPTIMIZED MODE (Low backlight + WiFi power cycling) ===");
+
+  // Configure power saving FIRST (before any high-power operations)
+  configurePowerSaving();
+
+  randomSeed(esp_random());
+  startNetworkTasks();
+
+  // Timer wake from deep sleep: state is still in RTC memory, skip the boot sequence
+  if (resumeFromDeepSleep()) {
+    return;
+  }
+
+  priceIntervalJitter = random(0, PRICE_INTERVAL_JITTER_MS);
+
+  // A slot counted from boot drifts with every unit's boot time; move it to the wall clock
+  if (!firmwareSlotOnWallClock && time(NULL) >= CLOCK_VALID_AFTER) {
+    lastFirmwareCheck = now;
+    scheduleFirmwareCheck(now);
+  }
+  resetMemoryTelemetry();
+
+  setupBacklight();              // Turn on backlight at low brightness
+  setupBatteryMonitor();         // Calibrated ADC + background sampler
+  loadPriceHistory();            // RTC copy, else the NVS spill
+  bool restored = restoreLastQuotes();
+
+  setupDisplay();
+  checkBattery();                // Initial battery check (may shut down)
+  if (restored) {
+    // Last known price and sparkline, marked stale until the first fetch lands
+    drawDisplayedPair();
+    lastPairRotation = uptimeMs();
+  } else {
+    frame.setTextColor(PAL_TEXT, PAL_BG);
+    frame.setTextDatum(MC_DATUM);
+    frame.drawString("BTC Display", SCREEN_WIDTH/2, SCREEN_HEIGHT/2-15, 4);
+    char versionStr[32];
+    snprintf(versionStr, sizeof(versionStr), "v%s", FIRMWARE_VERSION);
+    frame.drawString(versionStr, SCREEN_WIDTH/2, SCREEN_HEIGHT/2+15, 2);
+    flushDisplay();
+  }
+  Serial.printf("[INIT] First frame after %lums (%s)\n", millis(), restored ? "last known price" : "splash");
+
+  // First connect and fetch run on the network task; loop() draws the results
+  startNetworkJob(NET_JOB_BOOT);
+
+  Serial.println("\n[INIT] Setup complete!");
+  Serial.println("[INIT] Device ready - WiFi will reconnect for updates");
+  Serial.print("[INIT] Price update interval: ");
+  Serial.print(PRICE_INTERVAL_PLUGGED_MS / 60000);
+  Serial.print(" min on USB, ");
+  Serial.print(PRICE_INTERVAL_BATTERY_MS / 3600000);
+  Serial.print("-");
+  Serial.print(PRICE_INTERVAL_MAX_MS / 3600000);
+  Serial.println(" hours on battery");
+  Serial.print("[INIT] Firmware update interval: ");
+  Serial.print(FIRMWARE_UPDATE_INTERVAL / 3600000);
+  Serial.print(" hours in ");
+  Serial.print(FIRMWARE_ROLLOUT_SLOTS);
+  Serial.println(" rollout slots");
+}
+
+void loop() {
+  handleUiEvents();
+  unsigned long now = uptimeMs();
+
+  // --- Battery: apply whatever the background sampler reported ---
+  checkBattery();
+  drawStaleIndicator();  // Restored price: keep its age current
+
+  // --- Rotate through the configured pairs (no network needed) ---
+  if (PRICE_PAIR_COUNT > 1 && now - lastPairRotation >= PAIR_ROTATE_INTERVAL_MS) {
+    rotateDisplayedPair();
+    lastPairRotation = now;
+  }
+
+  if (networkBusy) {
+    // The radio is in use: no sleep, just block until an event or the next UI deadline
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeUntilUiDeadline(uptimeMs())));
+    return;
+  }
+
+  // Price and firmware work share one WiFi session when they fall close together
+  if (networkWindowDue(now)) {
+    startNetworkJob(NET_JOB_WINDOW);
+    return;
+  }
+
+  // On USB power the ticker feed replaces polling until unplugged
+  if (priceStreamDueIn(now) == 0) {
+    startNetworkJob(NET_JOB_STREAM);
+    return;
+  }
+
+#if DIAGNOSTICS_ENABLED
+  // Diagnostics endpoint follows USB power; unplugging turns the radio off
+  if (isPluggedIn != diagnosticsRunning() &&
+      (!isPluggedIn || lastDiagnosticsJob == 0 || now - lastDiagnosticsJob >= DIAGNOSTICS_RETRY_MS)) {
+    lastDiagnosticsJob = now;
+    startNetworkJob(NET_JOB_DIAGNOSTICS);
+    return;
+  }
+#endif
+
+  // Idle until the next price, firmware or battery deadline
+  sleepUntilNextDeadline(uptimeMs());
+}
+
+// ========== TASKS AND UI EVENTS ==========
+// With a restored price on screen the refresh runs without status screens
+static void runBootJob() {
+  connectWifi(!priceRestored);
+
+  if (wifiConnected) {
+    if (!priceRestored) postScreen(UI_SCREEN_LOADING);
+
+    // Fill the sparkline first: samples must be pushed oldest to newest
+    backfillPriceHistory();
+
+    // Fetch current price immediately
+    Serial.println("[INIT] Fetching current price...");
+    UiEvent event = {};
+    event.type = UI_EVENT_PRICE;
+    event.ok = fetchCurrentPrice(event.quotes);
+    Serial.println(event.ok ? "[INIT] Price fetched successfully" : "[INIT] Price fetch failed");
+    postUiEvent(event);
+
+    releaseWifi();
+
+    recentMoveBp = historyRecentMoveBp(priceHistory, PRICE_VOLATILITY_WINDOW_S);
+    lastPriceUpdate = uptimeMs();
+  } else if (priceRestored) {
+    Serial.println("[INIT] WiFi failed, keeping the last known price");
+  } else {
+    postScreen(UI_SCREEN_WIFI_ERROR);
+  }
+
+  // Even without WiFi: a fleet booting before its router must not check 24 h later in step
+  lastFirmwareCheck = uptimeMs();
+  scheduleFirmwareCheck(lastFirmwareCheck);  // Re-aimed by finishPriceTask() once the clock is set
+}
+
+// Network worker: sleeps on its notification until loop() hands it a job
+static void networkTaskMain(void* param) {
+  for (;;) {
+    uint32_t job = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &job, portMAX_DELAY);
+
+    beginPhase(networkPhases, PHASE_SESSION);
+    if (job == NET_JOB_BOOT) {
+      runBootJob();
+    } else if (job == NET_JOB_WINDOW) {
+      runNetworkWindow(uptimeMs());
+    } else if (job == NET_JOB_DIAGNOSTICS) {
+      runDiagnosticsJob();
+    } else if (job == NET_JOB_STREAM) {
+      runPriceStream();
+    }
+    endPhase(networkPhases, PHASE_SESSION);
+
+    // Job finished, WiFi is off again. A flag, not an event: a full queue must not leave networkBusy stuck
+    networkJobDone.store(true, std::memory_order_release);
+    xTaskNotifyGive(uiTaskHandle);
+  }
+}
+
+void startNetworkTasks() {
+  historyMutex = xSemaphoreCreateMutex();
+  uiTaskHandle = xTaskGetCurrentTaskHandle();
+  xTaskCreatePinnedToCore(networkTaskMain, "network", NETWORK_TASK_STACK, NULL,
+                          NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+}
+
+void startNetworkJob(NetworkJob job) {
+  networkBusy = true;
+  xTaskNotify(networkTaskHandle, job, eSetValueWithOverwrite);
+}
+
+// Network task side: queue the event and wake loop() if it is blocked
+void postUiEvent(const UiEvent& event) {
+  if (!uiEvents.push(event)) {
+    Serial.println("[UI] Event queue full, event dropped");
+  }
+  xTaskNotifyGive(uiTaskHandle);
+}
+
+void postScreen(UiScreen screen, const char* detail) {
+  UiEvent event = {};
+  event.type = UI_EVENT_SCREEN;
+  event.screen = screen;
+  strlcpy(event.detail, detail, sizeof(event.detail));
+  postUiEvent(event);
+}
+
+// UI side: apply and draw everything the network task reported
+void handleUiEvents() {
+  // Read first: every event the finished job posted is then already in the queue
+  bool jobDone = networkJobDone.exchange(false, std::memory_order_acquire);
+
+  UiEvent event;
+  while (uiEvents.pop(event)) {
+    switch (event.type) {
+      case UI_EVENT_SCREEN:
+        beginPhase(uiPhases, PHASE_DRAW);
+        drawStatusScreen(event.screen, event.detail);
+        endPhase(uiPhases, PHASE_DRAW);
+        break;
+
+      case UI_EVENT_PRICE:
+        if (event.ok) {
+          memcpy(pairQuotes, event.quotes, sizeof(pairQuotes));
+          currentPrice = pairQuotes[0].price;
+          pairQuotesTime = (uint32_t)time(NULL);
+          priceRestored = false;
+        }
+        currentPriceOk = event.ok;  // A restored price stays up regardless, see drawDisplayedPair()
+        beginPhase(uiPhases, PHASE_DRAW);
+        drawDisplayedPair();
+        endPhase(uiPhases, PHASE_DRAW);
+        if (!event.live) lastPairRotation = uptimeMs();
+        break;
+
+      case UI_EVENT_OTA_PROGRESS:
+        beginPhase(uiPhases, PHASE_DRAW);
+        drawOtaProgress(event.percent);
+        endPhase(uiPhases, PHASE_DRAW);
+        break;
+    }
+  }
+
+  if (jobDone) {
+    networkBusy = false;
+    closeEnergyRecord();
+    checkHeapFragmentation();  // Safe point: the new price is on screen
+  }
+}
+
+void drawStatusScreen(uint8_t screen, const char* detail) {
+  clearScreen();
+  frame.setTextDatum(MC_DATUM);
+
+  switch (screen) {
+    case UI_SCREEN_CONNECTING:
+      frame.setTextColor(PAL_TEXT, PAL_BG);
+      frame.drawString("Connecting WiFi...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+      break;
+
+    case UI_SCREEN_CONNECTED:
+      frame.setTextColor(PAL_TEXT, PAL_BG);
+      frame.drawString("WiFi Connected!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+      break;
+
+    case UI_SCREEN_WIFI_FAILED:
+      frame.setTextColor(PAL_ERROR, PAL_BG);
+      frame.drawString("WiFi Failed!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+      break;
+
+    case UI_SCREEN_LOADING:
+      frame.setTextColor(PAL_TEXT, PAL_BG);
+      frame.drawString("Loading...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+      break;
+
+    case UI_SCREEN_WIFI_ERROR:
+      frame.setTextColor(PAL_ERROR, PAL_BG);
+      frame.drawString("WiFi Error!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 4);
+      break;
+
+    case UI_SCREEN_OTA:
+      frame.setTextColor(PAL_WARNING, PAL_BG);
+      frame.drawString("FIRMWARE UPDATE", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 20, 4);
+      frame.setTextColor(PAL_TEXT, PAL_BG);
+      frame.drawString("Downloading...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 10, 2);
+      frame.setTextColor(PAL_ERROR, PAL_BG);
+      frame.drawString("DO NOT POWER OFF", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 35, 2);
+      otaShownFill = 0;
+      break;
+
+    case UI_SCREEN_OTA_FAILED:
+      frame.setTextColor(PAL_ERROR, PAL_BG);
+      frame.drawString("UPDATE FAILED!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 10, 4);
+      frame.setTextColor(PAL_TEXT, PAL_BG);
+      frame.drawString(detail, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
+      break;
+
+    case UI_SCREEN_OTA_DONE:
+      frame.setTextColor(PAL_CHART, PAL_BG);
+      frame.drawString("UPDATE COMPLETE!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 10, 4);
+      frame.drawString("Rebooting...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
+      break;
+  }
+  flushDisplay();
+}
+
+
+// ========== NETWORK WINDOW ==========
+// Re-evaluated on every check, so plugging in or a sagging cell takes effect right away
+static unsigned long priceInterval() {
+  bool externalPower = isPluggedIn || batteryVoltage < BATTERY_ABSENT_VOLTAGE;
+  return refreshIntervalMs(priceRefreshPolicy, externalPower, (uint16_t)(batteryVoltage * 1000),
+                           recentMoveBp);
+}
+
+static unsigned long priceDueIn(unsigned long now) {
+  return remainingUntil(lastPriceUpdate, priceInterval() + priceIntervalJitter, now);
+}
+
+static void runPriceTask(unsigned long now) {
+  Serial.println("\n[UPDATE] Fetching price...");
 
-  // Configure power saving FIRST (before any high-power operations)
-  configurePowerSaving();
+  // Apply exponential backoff if there have been consecutive failures
+  if (consecutiveApiFailures > 0) {
+    int backoff = calculateBackoff(consecutiveApiFailures);
+    Serial.print("[API] Applying backoff: ");
+    Serial.print(backoff / 1000);
+    Serial.print("s (attempt ");
+    Serial.print(consecutiveApiFailures + 1);
+    Serial.println(")");
 
-  randomSeed(esp_random());
-  PRICE_UPDATE_INTERVAL = PRICE_UPDATE_INTERVAL_BASE + random(0, 10000);
-
-  ledcSetup(BACKLIGHT_PWM_CHANNEL, 5000, 8);
-  ledcAttachPin(BACKLIGHT_PIN, BACKLIGHT_PWM_CHANNEL);
-  ledcWrite(BACKLIGHT_PWM_CHANNEL, BACKLIGHT_FULL);  // Turn on backlight at low brightness
-  pinMode(BATTERY_PIN, INPUT);  // Configure battery ADC pin
-  analogReadResolution(12);      // 12-bit ADC resolution (0-4095)
-  checkBattery();                // Initial battery check
-
-  tft.init(); tft.setRotation(1); tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_TEXT, COLOR_BG);
-  tft.setTextDatum(MC_DATUM);
-  tft.drawString("BTC Display", SCREEN_WIDTH/2, SCREEN_HEIGHT/2-15, 4);
-  char versionStr[32];
-  snprintf(versionStr, sizeof(versionStr), "v%s", FIRMWARE_VERSION);
-  tft.drawString(versionStr, SCREEN_WIDTH/2, SCREEN_HEIGHT/2+15, 2);
-  delay(1000);
-
-  connectWifi();
+    // Only the network task waits; the UI keeps drawing and watching the battery
+    vTaskDelay(pdMS_TO_TICKS(backoff));
+  }
 
-  if (wifiConnected) {
-    tft.fillScreen(COLOR_BG);
-    tft.drawString("Loading...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+  UiEvent event = {};
+  event.type = UI_EVENT_PRICE;
+  event.ok = fetchCurrentPrice(event.quotes);
+  postUiEvent(event);
+}
 
-    // Fetch current price immediately
-    Serial.println("[INIT] Fetching current price...");
-    if (fetchCurrentPrice(currentPrice)) {
-      Serial.println("[INIT] Price fetched successfully");
-      drawPrice(currentPrice, true);
-    } else {
-      Serial.println("[INIT] Price fetch failed");
-      drawPrice(0, false);
+static void finishPriceTask(unsigned long now) {
+  // Only the network task writes the ring, so reading it here needs no lock
+  recentMoveBp = historyRecentMoveBp(priceHistory, PRICE_VOLATILITY_WINDOW_S);
+  lastPriceUpdate = now;
+  priceIntervalJitter = random(0, PRICE_INTERVAL_JITTER_MS);
+
+  Serial.printf("[UPDATE] Next price in %lus (%s, %.2fV, %u.%02u%% move)\n",
+                (priceInterval() + priceIntervalJitter) / 1000,
+                isPluggedIn ? "USB" : "battery", batteryVoltage,
+                (unsigned)(recentMoveBp / 100), (unsigned)(recentMoveBp % 100));
+}
+
+/**
+ * Aim the next firmware check at this unit's rollout slot. With the wall
+ * clock set the slots are fixed times of day, so a fleet that boots
+ * together after an outage still checks (and downloads) hours apart, and
+ * most of those checks cost only a 304. Without a clock the same offset
+ * is counted from boot.
+ */
+void scheduleFirmwareCheck(unsigned long now) {
+  const uint32_t periodS = FIRMWARE_UPDATE_INTERVAL / 1000;
+
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  RolloutSlot slot = rolloutSlot(mac, sizeof(mac), periodS, FIRMWARE_ROLLOUT_SLOTS);
+
+  time_t wall = time(NULL);
+  bool clockSet = wall >= CLOCK_VALID_AFTER;
+  uint32_t base = clockSet ? (uint32_t)wall : now / 1000;
+  uint32_t waitS = secondsUntilSlot(base, periodS, slot.offsetS, FIRMWARE_MIN_CHECK_GAP_MS / 1000);
+  firmwareCheckDelay = waitS * 1000UL;
+  firmwareSlotOnWallClock = clockSet;
+
+  Serial.printf("[OTA] Rollout slot %u/%u, next check in %luh%02lum (%s)\n",
+                slot.slot + 1, FIRMWARE_ROLLOUT_SLOTS, (unsigned long)(waitS / 3600),
+                (unsigned long)(waitS / 60 % 60), clockSet ? "wall clock" : "since boot");
+}
+
+static unsigned long firmwareDueIn(unsigned long now) {
+  return remainingUntil(lastFirmwareCheck, firmwareCheckDelay, now);
+}
+
+static void runFirmwareTask(unsigned long now) {
+  Serial.println("\n[UPDATE] Checking for firmware updates...");
+  checkForFirmwareUpdate();  // Restarts the device if an update is installed
+}
+
+static void finishFirmwareTask(unsigned long now) {
+  lastFirmwareCheck = now;
+  scheduleFirmwareCheck(now);
+}
+
+// Run order within a session: cheapest and most visible first
+static const NetworkTask networkTasks[] = {
+  { "price",    priceDueIn,    runPriceTask,    finishPriceTask },
+  { "firmware", firmwareDueIn, runFirmwareTask, finishFirmwareTask },
+};
+static const size_t NETWORK_TASK_COUNT = sizeof(networkTasks) / sizeof(networkTasks[0]);
+
+/**
+ * Open one WiFi session when any network task is due, and run every task
+ * due within NETWORK_LOOKAHEAD_MS in it, so two deadlines a few minutes
+ * apart cost one association instead of two.
+ */
+bool networkWindowDue(unsigned long now) {
+  for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+    if (networkTasks[i].dueIn(now) == 0) return true;
+  }
+  return false;
+}
+
+void runNetworkWindow(unsigned long now) {
+  bool batch[NETWORK_TASK_COUNT];
+  for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+    batch[i] = (networkTasks[i].dueIn(now) <= NETWORK_LOOKAHEAD_MS);
+  }
+
+  Serial.print("\n[NET] Network window:");
+  for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+    if (batch[i]) {
+      Serial.print(" ");
+      Serial.print(networkTasks[i].name);
+    }
+  }
+  Serial.println();
+
+  // Still up on USB power, unless the AP dropped us meanwhile
+  if (!wifiConnected || !WiFi.isConnected()) {
+    connectWifi();
+  }
+
+  if (wifiConnected) {
+    for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+      if (batch[i]) networkTasks[i].run(now);
     }
 
-    // Disconnect WiFi to save power
-    disconnectWifi();
+    releaseWifi();
+  }
+
+  // A failed connection still counts as an attempt; retry next interval
+  for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+    if (batch[i]) networkTasks[i].finish(now);
+  }
+}
+
+// ========== ENERGY ACCOUNTING ==========
+// Crypto and parsing are CPU-bound: finish them at the boost clock so the radio goes off sooner
+static bool phaseBoostsCpu(uint8_t phase) {
+  return phase == PHASE_TLS || phase == PHASE_PARSE;
+}
+
+static bool phaseRunning(const PhaseTimer& timer, uint8_t phase) {
+  return (timer.running & (1u << phase)) != 0;
+}
+
+void beginPhase(PhaseTimer& timer, uint8_t phase) {
+  if (phaseBoostsCpu(phase) && !phaseRunning(timer, phase)) setCpuBoost(true);
+  phaseBegin(timer, phase, esp_timer_get_time());
+}
+
+void endPhase(PhaseTimer& timer, uint8_t phase) {
+  bool boosted = phaseBoostsCpu(phase) && phaseRunning(timer, phase);
+  phaseEnd(timer, phase, esp_timer_get_time());
+  if (boosted) setCpuBoost(false);
+
+  // The heap is tightest right after these: TLS buffers up, JSON document alive
+  if (phase == PHASE_TLS) sampleMemory(MEM_PHASE_TLS);
+  else if (phase == PHASE_PARSE) sampleMemory(MEM_PHASE_PARSE);
+}
+
+/**
+ * Close the current wake once the network job is done: the network task
+ * has posted its last event, so its phase totals are final and loop() is
+ * the only one touching either timer until the next job starts.
+ */
+void closeEnergyRecord() {
+  unsigned long now = uptimeMs();
+  WakeEnergy record;
+  energyClose(record, networkPhases, uiPhases, energyModel, now / 1000,
+              now - lastEnergyRecordMs, energySleepMs, (uint16_t)(batteryVoltage * 1000));
+  energyLogPush(energyLog, record);
+
+  phaseReset(networkPhases);
+  phaseReset(uiPhases);
+  lastEnergyRecordMs = now;
+  energySleepMs = 0;
+
+  printEnergyRecord(record);
+}
+
+void printEnergyRecord(const WakeEnergy& record) {
+  Serial.printf("[ENERGY] Wake (%s):", cpuPolicyName());
+  for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+    Serial.printf(" %s %lums", energyPhaseName(p), (unsigned long)record.phaseMs[p]);
+  }
+  Serial.printf(", awake %lus, asleep %lus\n",
+                (unsigned long)((record.windowMs - record.sleepMs) / 1000),
+                (unsigned long)(record.sleepMs / 1000));
+  Serial.printf("[ENERGY] ~%lu uAh (%lu mJ) this wake, ~%lu uAh/h over the last %u wakes\n",
+                (unsigned long)energyMicroAmpHours(record), (unsigned long)energyMillijoules(record),
+                (unsigned long)energyLogMicroAmpHoursPerHour(energyLog), energyLog.count);
+}
 
-    lastPriceUpdate = millis();
-    lastFirmwareCheck = millis();
+// ========== MEMORY TELEMETRY ==========
+// Worst heap state per phase, kept across deep sleep. Stack high-water
+// marks come from FreeRTOS, which tracks them per task since creation.
+RTC_DATA_ATTR MemoryWatermarks memoryWatermarks;
+RTC_NOINIT_ATTR uint32_t heapRebootMagic;
+RTC_NOINIT_ATTR uint32_t heapRebootCount;  // Consecutive defragmenting restarts
+
+void sampleMemory(uint8_t phase) {
+  memoryRecord(memoryWatermarks, phase, heap_caps_get_free_size(MALLOC_CAP_8BIT),
+               heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
 
+// Cold boot: start fresh peaks and report a fragmentation reboot, if that was us
+void resetMemoryTelemetry() {
+  memoryReset(memoryWatermarks);
+  if (esp_reset_reason() == ESP_RST_SW && heapRebootMagic == HEAP_REBOOT_MAGIC) {
+    Serial.printf("[HEAP] Restarted to defragment the heap (%u so far)\n", heapRebootCount);
   } else {
-    tft.fillScreen(COLOR_BG);
-    tft.setTextColor(COLOR_ERROR, COLOR_BG);
-    tft.drawString("WiFi Error!", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 4);
+    heapRebootCount = 0;
   }
+  heapRebootMagic = 0;
+}
 
-  Serial.println("\n[INIT] Setup complete!");
-  Serial.println("[INIT] Device ready - WiFi will reconnect for updates");
-  Serial.print("[INIT] Price update interval: ");
-  Serial.print(PRICE_UPDATE_INTERVAL_BASE / 3600000);
-  Serial.println(" hours");
-  Serial.print("[INIT] Firmware update interval: ");
-  Serial.print(FIRMWARE_UPDATE_INTERVAL / 3600000);
-  Serial.println(" hours");
+struct TaskStack {
+  const char* name;
+  uint32_t unusedBytes;   // ESP-IDF counts the high-water mark in bytes, not words
+};
+#define WATCHED_TASK_COUNT 4
+
+// Tasks whose unused stack is reported; returns how many exist right now
+size_t watchedTaskStacks(TaskStack* out) {
+  const char* const names[WATCHED_TASK_COUNT] = { "network", "loop", "esp_timer", "httpd" };
+  TaskHandle_t tasks[WATCHED_TASK_COUNT] = {
+    networkTaskHandle, uiTaskHandle, xTaskGetHandle("esp_timer"), xTaskGetHandle("httpd")
+  };
+  size_t n = 0;
+  for (size_t i = 0; i < WATCHED_TASK_COUNT; i++) {
+    if (tasks[i] == NULL) continue;
+    out[n].name = names[i];
+    out[n].unusedBytes = uxTaskGetStackHighWaterMark(tasks[i]);
+    n++;
+  }
+  return n;
 }
 
-void loop() {
-  unsigned long now = millis();
+void printMemoryStats() {
+  uint32_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  Serial.printf("[HEAP] Free %u (low-water %u), largest block %u, fragmentation %u%%\n",
+                freeBytes, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+                largest, heapFragmentation(freeBytes, largest));
+
+  for (uint8_t p = 0; p < MEM_PHASE_COUNT; p++) {
+    const MemoryPeak& peak = memoryWatermarks.phase[p];
+    if (peak.samples == 0) continue;
+    Serial.printf("[HEAP] Peak %s: free %u, largest block %u, fragmentation %u%% (%u samples)\n",
+                  memoryPhaseName(p), peak.minFree, peak.minLargestBlock,
+                  peak.maxFragmentation, peak.samples);
+  }
 
-  // --- Battery check every 30 seconds ---
-  if (now - lastBatteryCheck >= BATTERY_CHECK_INTERVAL) {
-    checkBattery();
-    lastBatteryCheck = now;
-    if (batteryLow || batteryCritical) {
-      drawBatteryWarning();
-    }
+  TaskStack stacks[WATCHED_TASK_COUNT];
+  size_t taskCount = watchedTaskStacks(stacks);
+  Serial.print("[STACK] Unused:");
+  for (size_t i = 0; i < taskCount; i++) {
+    Serial.printf(" %s %u", stacks[i].name, stacks[i].unusedBytes);
+  }
+  Serial.println();
+}
 
-    // Check if device is plugged in (for battery display indicator)
-    wasPluggedIn = isPluggedIn;
-    isPluggedIn = checkIfPluggedIn();
+/**
+ * Runs in loop() once a network job is over and its price has been drawn.
+ * With the radio off (or idle, on USB) every TLS buffer is back on the heap, so a
+ * largest block too small for the next handshake means fragmentation, not
+ * load. A restart is the only defragmenter: do it now, while the display
+ * is consistent and the price history is already in NVS, rather than let
+ * the next fetch fail. If fetches are already failing there is nothing on
+ * screen to lose either. A restart that did not help doubles the uptime
+ * the next one waits for, so a heap that comes up fragmented (a leak, an
+ * oversized config) degrades to a daily restart instead of a boot loop.
+ */
+void checkHeapFragmentation() {
+  sampleMemory(MEM_PHASE_IDLE);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  unsigned long uptime = uptimeMs();
+  if (largest >= HEAP_TLS_MIN_BLOCK) {
+    if (heapRebootCount > 0 && uptime >= HEAP_REBOOT_HOLDOFF_MAX_MS) heapRebootCount = 0;
+    return;
+  }
 
-    // Detect plug-in event (transition from unplugged to plugged)
-    if (isPluggedIn && !wasPluggedIn) {
-      Serial.println("\n[POWER] 🔌 Device plugged in detected!");
-      Serial.print("[POWER] Voltage: ");
-      Serial.print(batteryVoltage, 2);
-      Serial.println("V (charging)");
-      drawBatteryWarning();  // Update display to show charging indicator
-    }
+  unsigned long holdOff = HEAP_REBOOT_HOLDOFF_MAX_MS;
+  if (heapRebootCount < 8) holdOff = min((unsigned long)HEAP_REBOOT_HOLDOFF_MS << heapRebootCount, holdOff);
+  if (uptime < holdOff) {
+    Serial.printf("[HEAP] ⚠️ Largest block %u < %u, %u restarts in a row, holding off for %lus\n",
+                  largest, HEAP_TLS_MIN_BLOCK, heapRebootCount, (holdOff - uptime) / 1000);
+    return;
+  }
 
-    // Detect unplug event
-    if (!isPluggedIn && wasPluggedIn) {
-      Serial.println("\n[POWER] 🔋 Device unplugged - running on battery");
-      Serial.print("[POWER] Voltage: ");
-      Serial.print(batteryVoltage, 2);
-      Serial.println("V");
-      drawBatteryWarning();  // Update display to clear charging indicator
-    }
+  if (!currentPriceOk && consecutiveApiFailures < HEAP_REBOOT_AFTER_FAILURES) {
+    Serial.printf("[HEAP] ⚠️ Largest block %u < %u, rebooting after the next good price\n",
+                  largest, HEAP_TLS_MIN_BLOCK);
+    return;
   }
 
-  // Check if any updates are needed
-  bool needsPriceUpdate = (now - lastPriceUpdate >= PRICE_UPDATE_INTERVAL);
-  bool needsFirmwareUpdate = (now - lastFirmwareCheck >= FIRMWARE_UPDATE_INTERVAL);
+  Serial.printf("[HEAP] ⚠️ Largest block %u < %u needed for TLS, rebooting\n",
+                largest, HEAP_TLS_MIN_BLOCK);
+  printMemoryStats();
+  heapRebootMagic = HEAP_REBOOT_MAGIC;
+  heapRebootCount++;
+  Serial.flush();
+  esp_restart();
+}
 
-  // --- Price update ---
-  if (needsPriceUpdate) {
-    Serial.println("\n[UPDATE] Fetching price...");
+// ========== DIAGNOSTICS ENDPOINT ==========
+/**
+ * Read-only views served while on USB power. Handlers run on the server
+ * task while the network task and loop() carry on, so counters are a
+ * best-effort snapshot; only history samples, which the network task
+ * rewrites in place, are copied out under historyMutex.
+ */
+static void writeDiagnosticsJson(DiagnosticsOutput& out);
+static void writeHistoryJson(DiagnosticsOutput& out);
+static void writeMetrics(DiagnosticsOutput& out);
+
+static const DiagnosticsRoute diagnosticsRoutes[] = {
+  { "/",        "application/json",          writeDiagnosticsJson },
+  { "/history", "application/json",          writeHistoryJson },
+  { "/metrics", "text/plain; version=0.0.4", writeMetrics },  // Prometheus text format
+};
+
+void startDiagnostics() {
+  if (diagnosticsRunning()) return;
+
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  char hostname[DIAGNOSTICS_HOSTNAME_LEN];
+  snprintf(hostname, sizeof(hostname), "%s-%02x%02x%02x",
+           DIAGNOSTICS_HOSTNAME_PREFIX, mac[3], mac[4], mac[5]);
+  diagnosticsStart(hostname, diagnosticsRoutes, sizeof(diagnosticsRoutes) / sizeof(diagnosticsRoutes[0]));
+}
 
-    // Reconnect WiFi for price update
-    if (!wifiConnected) {
-      connectWifi();
-    }
+// NET_JOB_DIAGNOSTICS: follow the power source without touching the display
+void runDiagnosticsJob() {
+  if (!isPluggedIn) {
+    disconnectWifi();
+    return;
+  }
+  if (!wifiConnected || !WiFi.isConnected()) {
+    connectWifi(false);
+  }
+  releaseWifi();
+}
 
-    if (wifiConnected) {
-      // Apply exponential backoff if there have been consecutive failures
-      if (consecutiveApiFailures > 0) {
-        int backoff = calculateBackoff(consecutiveApiFailures);
-        Serial.print("[API] Applying backoff: ");
-        Serial.print(backoff / 1000);
-        Serial.print("s (attempt ");
-        Serial.print(consecutiveApiFailures + 1);
-        Serial.println(")");
+static const char* jsonBool(bool value) {
+  return value ? "true" : "false";
+}
 
-        // Non-blocking backoff
-        unsigned long backoffUntil = millis() + backoff;
-        while (millis() < backoffUntil) {
-          checkBattery();
-          delay(100);
-        }
-      }
+static void writeDiagnosticsJson(DiagnosticsOutput& out) {
+  unsigned long now = uptimeMs();
+  diagPrintf(out, "{\"version\":\"%s\",\"uptime_s\":%lu,\"battery_mv\":%u,\"usb\":%s,",
+             FIRMWARE_VERSION, now / 1000, batteryMillivolts, jsonBool(isPluggedIn));
+  diagPrintf(out, "\"price_ok\":%s,\"price_restored\":%s,\"price_age_s\":%lu,\"refresh_s\":%lu,"
+             "\"api_failures\":%d,\"quotes\":[",
+             jsonBool(currentPriceOk), jsonBool(priceRestored), (now - lastPriceUpdate) / 1000,
+             priceInterval() / 1000, consecutiveApiFailures);
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    diagPrintf(out, "%s{\"pair\":\"%s\",\"price\":%.2f,\"ok\":%s}", i ? "," : "",
+               PRICE_PAIRS[i].label, pairQuotes[i].price, jsonBool(pairQuotes[i].ok));
+  }
 
-      bool success = fetchCurrentPrice(currentPrice);
+  uint32_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  diagPrintf(out, "],\"heap\":{\"free\":%u,\"min_free\":%u,\"largest\":%u,\"fragmentation\":%u,\"phases\":{",
+             freeBytes, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             largest, heapFragmentation(freeBytes, largest));
+  bool first = true;
+  for (uint8_t p = 0; p < MEM_PHASE_COUNT; p++) {
+    const MemoryPeak& peak = memoryWatermarks.phase[p];
+    if (peak.samples == 0) continue;
+    diagPrintf(out, "%s\"%s\":{\"min_free\":%u,\"min_largest\":%u,\"max_fragmentation\":%u,\"samples\":%u}",
+               first ? "" : ",", memoryPhaseName(p), peak.minFree, peak.minLargestBlock,
+               peak.maxFragmentation, peak.samples);
+    first = false;
+  }
 
-      if (success) {
-        drawPrice(currentPrice, true);
-      } else {
-        drawPrice(currentPrice, false);
-      }
+  TaskStack stacks[WATCHED_TASK_COUNT];
+  size_t taskCount = watchedTaskStacks(stacks);
+  diagPrintf(out, "}},\"stack_unused\":{");
+  for (size_t i = 0; i < taskCount; i++) {
+    diagPrintf(out, "%s\"%s\":%u", i ? "," : "", stacks[i].name, stacks[i].unusedBytes);
+  }
 
-      // Disconnect WiFi to save power
-      disconnectWifi();
+  diagPrintf(out, "},\"tls_bounds_ms\":[");
+  for (size_t b = 0; b < TLS_HISTOGRAM_BUCKETS - 1; b++) {
+    diagPrintf(out, "%s%u", b ? "," : "", TLS_HISTOGRAM_BOUNDS_MS[b]);
+  }
+  diagPrintf(out, "],\"tls\":[");
+  for (size_t i = 0; i < tlsStatsCount(); i++) {
+    const TlsHandshakeStats& t = *tlsStats(i);
+    diagPrintf(out, "%s{\"host\":\"%s\",\"full\":%u,\"resumed\":%u,\"failed\":%u,"
+               "\"full_avg_ms\":%u,\"resumed_avg_ms\":%u,\"ttfb_avg_ms\":%u,\"handshake_ms\":[",
+               i ? "," : "", t.host, t.fullCount, t.resumedCount, t.failedCount,
+               t.fullCount ? t.fullTotalMs / t.fullCount : 0,
+               t.resumedCount ? t.resumedTotalMs / t.resumedCount : 0,
+               t.ttfbCount ? t.ttfbTotalMs / t.ttfbCount : 0);
+    for (size_t b = 0; b < TLS_HISTOGRAM_BUCKETS; b++) {
+      diagPrintf(out, "%s%u", b ? "," : "", t.handshakeBuckets[b]);
     }
-
-    lastPriceUpdate = now;
-    PRICE_UPDATE_INTERVAL = PRICE_UPDATE_INTERVAL_BASE + random(0, 10000);
+    diagPrintf(out, "],\"ttfb_ms\":[");
+    for (size_t b = 0; b < TLS_HISTOGRAM_BUCKETS; b++) {
+      diagPrintf(out, "%s%u", b ? "," : "", t.ttfbBuckets[b]);
+    }
+    diagPrintf(out, "]}");
   }
 
-  // --- Firmware update check ---
-  if (needsFirmwareUpdate) {
-    Serial.println("\n[UPDATE] Checking for firmware updates...");
+  diagPrintf(out, "],\"sources\":[");
+  for (size_t i = 0; i < PRICE_SOURCE_COUNT; i++) {
+    const SourceHealth& h = sourceHealth[i];
+    diagPrintf(out, "%s{\"name\":\"%s\",\"latency_ms\":%u,\"error_score\":%u,\"available\":%s}",
+               i ? "," : "", priceSources[i].name, h.latencyMs, h.errorScore,
+               jsonBool(sourceAvailable(h, now)));
+  }
 
-    // Reconnect WiFi for firmware update check
-    if (!wifiConnected) {
-      connectWifi();
+  diagPrintf(out, "],\"energy\":{\"uah_per_h\":%u,\"wakes\":[", energyLogMicroAmpHoursPerHour(energyLog));
+  for (size_t i = 0; i < energyLog.count; i++) {
+    const WakeEnergy& w = energyLogAt(energyLog, i);
+    diagPrintf(out, "%s{\"uptime_s\":%u,\"window_ms\":%u,\"sleep_ms\":%u,\"battery_mv\":%u,\"uah\":%u,\"phase_ms\":{",
+               i ? "," : "", w.uptimeS, w.windowMs, w.sleepMs, w.batteryMv, energyMicroAmpHours(w));
+    for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+      diagPrintf(out, "%s\"%s\":%u", p ? "," : "", energyPhaseName(p), w.phaseMs[p]);
     }
+    diagPrintf(out, "}}");
+  }
+  diagPrintf(out, "]}}");
+}
+
+static void writeHistoryJson(DiagnosticsOutput& out) {
+  diagPrintf(out, "{\"window_s\":%u,\"samples\":[", SPARKLINE_WINDOW_S);
+  for (size_t i = 0; ; i++) {
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    bool more = i < priceHistory.count;
+    PriceSample sample = more ? historyAt(priceHistory, i) : PriceSample();
+    xSemaphoreGive(historyMutex);
+    if (!more) break;
+    diagPrintf(out, "%s[%u,%u.%02u]", i ? "," : "", sample.time, sample.cents / 100, sample.cents % 100);
+  }
+  diagPrintf(out, "]}");
+}
 
-    if (wifiConnected) {
-      checkForFirmwareUpdate();
+static void writeMetricHeader(DiagnosticsOutput& out, const char* name, const char* type, const char* help) {
+  diagPrintf(out, "# HELP btc_display_%s %s\n# TYPE btc_display_%s %s\n", name, help, name, type);
+}
 
-      // Disconnect WiFi to save power (only if update didn't happen - update restarts device)
-      disconnectWifi();
+// Cumulative buckets in seconds, as Prometheus histograms expect
+static void writeTimingHistogram(DiagnosticsOutput& out, const char* name, const char* host,
+                                 const uint32_t* buckets, uint32_t sumMs) {
+  uint32_t cumulative = 0;
+  for (size_t b = 0; b < TLS_HISTOGRAM_BUCKETS; b++) {
+    cumulative += buckets[b];
+    if (b < TLS_HISTOGRAM_BUCKETS - 1) {
+      uint16_t bound = TLS_HISTOGRAM_BOUNDS_MS[b];
+      diagPrintf(out, "btc_display_%s_bucket{host=\"%s\",le=\"%u.%03u\"} %u\n",
+                 name, host, bound / 1000, bound % 1000, cumulative);
+    } else {
+      diagPrintf(out, "btc_display_%s_bucket{host=\"%s\",le=\"+Inf\"} %u\n", name, host, cumulative);
     }
+  }
+  diagPrintf(out, "btc_display_%s_sum{host=\"%s\"} %u.%03u\n", name, host, sumMs / 1000, sumMs % 1000);
+  diagPrintf(out, "btc_display_%s_count{host=\"%s\"} %u\n", name, host, cumulative);
+}
 
-    lastFirmwareCheck = now;
+static void writeMetrics(DiagnosticsOutput& out) {
+  unsigned long now = uptimeMs();
+  writeMetricHeader(out, "info", "gauge", "Firmware version");
+  diagPrintf(out, "btc_display_info{version=\"%s\"} 1\n", FIRMWARE_VERSION);
+  writeMetricHeader(out, "uptime_seconds", "counter", "Uptime including deep sleep");
+  diagPrintf(out, "btc_display_uptime_seconds %lu\n", now / 1000);
+  writeMetricHeader(out, "battery_volts", "gauge", "Filtered battery voltage");
+  diagPrintf(out, "btc_display_battery_volts %u.%03u\n", batteryMillivolts / 1000, batteryMillivolts % 1000);
+  writeMetricHeader(out, "usb_power", "gauge", "1 while on external power");
+  diagPrintf(out, "btc_display_usb_power %d\n", isPluggedIn ? 1 : 0);
+
+  writeMetricHeader(out, "price", "gauge", "Last fetched price per pair");
+  for (size_t i = 0; i < PRICE_PAIR_COUNT; i++) {
+    if (!pairQuotes[i].ok) continue;
+    diagPrintf(out, "btc_display_price{pair=\"%s\"} %.2f\n", PRICE_PAIRS[i].label, pairQuotes[i].price);
+  }
+  writeMetricHeader(out, "price_age_seconds", "gauge", "Time since the last price fetch");
+  diagPrintf(out, "btc_display_price_age_seconds %lu\n", (now - lastPriceUpdate) / 1000);
+  writeMetricHeader(out, "api_failures", "gauge", "Consecutive failed price fetches");
+  diagPrintf(out, "btc_display_api_failures %d\n", consecutiveApiFailures);
+
+  uint32_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  writeMetricHeader(out, "heap_free_bytes", "gauge", "Free 8-bit heap");
+  diagPrintf(out, "btc_display_heap_free_bytes %u\n", freeBytes);
+  writeMetricHeader(out, "heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  diagPrintf(out, "btc_display_heap_min_free_bytes %u\n", heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+  writeMetricHeader(out, "heap_largest_block_bytes", "gauge", "Largest free heap block");
+  diagPrintf(out, "btc_display_heap_largest_block_bytes %u\n", heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+  writeMetricHeader(out, "heap_phase_min_largest_block_bytes", "gauge", "Smallest largest free block seen per phase");
+  for (uint8_t p = 0; p < MEM_PHASE_COUNT; p++) {
+    const MemoryPeak& peak = memoryWatermarks.phase[p];
+    if (peak.samples == 0) continue;
+    diagPrintf(out, "btc_display_heap_phase_min_largest_block_bytes{phase=\"%s\"} %u\n",
+               memoryPhaseName(p), peak.minLargestBlock);
+  }
+
+  TaskStack stacks[WATCHED_TASK_COUNT];
+  size_t taskCount = watchedTaskStacks(stacks);
+  writeMetricHeader(out, "stack_unused_bytes", "gauge", "Stack never touched since the task started");
+  for (size_t i = 0; i < taskCount; i++) {
+    diagPrintf(out, "btc_display_stack_unused_bytes{task=\"%s\"} %u\n", stacks[i].name, stacks[i].unusedBytes);
+  }
+
+  writeMetricHeader(out, "tls_handshakes_total", "counter", "TLS handshakes per host and outcome");
+  for (size_t i = 0; i < tlsStatsCount(); i++) {
+    const TlsHandshakeStats& t = *tlsStats(i);
+    diagPrintf(out, "btc_display_tls_handshakes_total{host=\"%s\",result=\"full\"} %u\n", t.host, t.fullCount);
+    diagPrintf(out, "btc_display_tls_handshakes_total{host=\"%s\",result=\"resumed\"} %u\n", t.host, t.resumedCount);
+    diagPrintf(out, "btc_display_tls_handshakes_total{host=\"%s\",result=\"failed\"} %u\n", t.host, t.failedCount);
+  }
+  writeMetricHeader(out, "tls_handshake_seconds", "histogram", "Successful TLS handshake time");
+  for (size_t i = 0; i < tlsStatsCount(); i++) {
+    const TlsHandshakeStats& t = *tlsStats(i);
+    writeTimingHistogram(out, "tls_handshake_seconds", t.host, t.handshakeBuckets,
+                         t.fullTotalMs + t.resumedTotalMs);
+  }
+  writeMetricHeader(out, "ttfb_seconds", "histogram", "Request write to first response byte");
+  for (size_t i = 0; i < tlsStatsCount(); i++) {
+    const TlsHandshakeStats& t = *tlsStats(i);
+    writeTimingHistogram(out, "ttfb_seconds", t.host, t.ttfbBuckets, t.ttfbTotalMs);
+  }
+
+  writeMetricHeader(out, "source_latency_seconds", "gauge", "EWMA request latency per price source");
+  for (size_t i = 0; i < PRICE_SOURCE_COUNT; i++) {
+    uint32_t ms = sourceHealth[i].latencyMs;
+    diagPrintf(out, "btc_display_source_latency_seconds{source=\"%s\"} %u.%03u\n",
+               priceSources[i].name, ms / 1000, ms % 1000);
+  }
+  writeMetricHeader(out, "source_error_ratio", "gauge", "EWMA failure rate per price source");
+  for (size_t i = 0; i < PRICE_SOURCE_COUNT; i++) {
+    uint16_t score = sourceHealth[i].errorScore;
+    diagPrintf(out, "btc_display_source_error_ratio{source=\"%s\"} %u.%03u\n",
+               priceSources[i].name, score / SOURCE_ERROR_SCALE, score % SOURCE_ERROR_SCALE);
+  }
+
+  writeMetricHeader(out, "drain_microamp_hours_per_hour", "gauge", "Estimated average drain over the logged wakes");
+  diagPrintf(out, "btc_display_drain_microamp_hours_per_hour %u\n", energyLogMicroAmpHoursPerHour(energyLog));
+}
+
+// ========== SLEEP SCHEDULER ==========
+/**
+ * Monotonic milliseconds that keep counting across deep sleep.
+ * millis() restarts at zero on every deep-sleep wake, so the time spent
+ * before sleeping is carried over in RTC memory.
+ */
+unsigned long uptimeMs() {
+  return (unsigned long)(rtcClockOffsetMs + millis());
+}
+
+unsigned long remainingUntil(unsigned long last, unsigned long interval, unsigned long now) {
+  unsigned long elapsed = now - last;
+  return (elapsed >= interval) ? 0 : interval - elapsed;
+}
+
+// Deadlines loop() serves itself, also while the network task is busy
+unsigned long timeUntilUiDeadline(unsigned long now) {
+  // esp_timer does not run during light sleep: wake by the next sample so it fires
+  unsigned long wait = remainingUntil(lastBatterySample, BATTERY_CHECK_INTERVAL, now);
+  if (PRICE_PAIR_COUNT > 1) {
+    wait = min(wait, remainingUntil(lastPairRotation, PAIR_ROTATE_INTERVAL_MS, now));
+  }
+  return wait;
+}
+
+unsigned long timeUntilNextDeadline(unsigned long now) {
+  unsigned long wait = timeUntilUiDeadline(now);
+  for (size_t i = 0; i < NETWORK_TASK_COUNT; i++) {
+    wait = min(wait, networkTasks[i].dueIn(now));
+  }
+  return min(wait, priceStreamDueIn(now));
+}
+
+void sleepUntilNextDeadline(unsigned long now) {
+#if DIAGNOSTICS_ENABLED
+  if (diagnosticsRunning()) {
+    // Light sleep would drop the association the server needs; idle in FreeRTOS
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeUntilNextDeadline(now)));
+    return;
   }
+#endif
 
+#if SLEEP_MODE == SLEEP_MODE_NONE
   delay(100);  // Small delay to prevent busy-waiting
+#else
+  unsigned long sleepMs = timeUntilNextDeadline(now);
+  if (sleepMs < MIN_SLEEP_MS) {
+    delay(sleepMs);
+    return;
+  }
+
+#if SLEEP_MODE == SLEEP_MODE_DEEP
+  if (sleepMs >= DEEP_SLEEP_MIN_MS) {
+    enterDeepSleep(sleepMs);  // Does not return
+  }
+#endif
+
+  Serial.flush();  // UART output is garbled if the clock stops mid-byte
+
+  // Keep the RTC 8MHz oscillator running so the backlight PWM stays lit
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, ESP_PD_OPTION_ON);
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+  int64_t sleepStart = esp_timer_get_time();
+  esp_light_sleep_start();
+  energySleepMs += (unsigned long)((esp_timer_get_time() - sleepStart) / 1000);
+#endif
+}
+
+void enterDeepSleep(unsigned long sleepMs) {
+  Serial.print("[POWER] Deep sleep for ");
+  Serial.print(sleepMs / 1000);
+  Serial.println("s");
+  Serial.flush();
+
+  // Carry the schedule clock over the reset that a deep-sleep wake causes
+  rtcClockOffsetMs += millis() + sleepMs;
+  energySleepMs += sleepMs;
+
+  // Backlight off; hold CS/RST high so the panel keeps its frame memory
+  setBacklight(0);
+  gpio_hold_en((gpio_num_t)BACKLIGHT_PIN);
+  gpio_hold_en((gpio_num_t)TFT_CS);
+  gpio_hold_en((gpio_num_t)TFT_RST);
+  gpio_deep_sleep_hold_en();
+
+  esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+  esp_deep_sleep_start();
+}
+
+/**
+ * Restore the display after a timer wake from deep sleep.
+ * Returns false on a normal power-on or reset, where setup() must run fully.
+ */
+bool resumeFromDeepSleep() {
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+    return false;
+  }
+
+  Serial.println("[POWER] Woke from deep sleep, resuming schedule");
+
+  gpio_deep_sleep_hold_dis();
+  gpio_hold_dis((gpio_num_t)BACKLIGHT_PIN);
+  gpio_hold_dis((gpio_num_t)TFT_CS);
+  gpio_hold_dis((gpio_num_t)TFT_RST);
+
+  setupBacklight();
+  setupBatteryMonitor();
+
+  setupDisplay();
+  drawDisplayedPair();
+
+  checkBattery();
+  lastPairRotation = uptimeMs();
+  return true;
 }
 
 // ========== CPU AND POWER OPTIMIZATION ==========
+/**
+ * With CPU_POLICY_DFS, esp_pm runs the CPU at CPU_FREQ_MHZ unless a
+ * CPU_FREQ_MAX lock is held; network phases that are CPU-bound take it
+ * (see beginPhase). If the core was built without PM support this falls
+ * back to the fixed clock.
+ */
+static esp_pm_lock_handle_t cpuBoostLock = NULL;
+static bool cpuAutoLightSleep = false;
+
+static bool startFrequencyScaling() {
+  esp_pm_config_esp32_t config = {};
+  config.max_freq_mhz = CPU_BOOST_FREQ_MHZ;
+  config.min_freq_mhz = CPU_FREQ_MHZ;
+  config.light_sleep_enable = CPU_AUTO_LIGHT_SLEEP;
+
+  esp_err_t err = esp_pm_configure(&config);
+  if (err == ESP_ERR_NOT_SUPPORTED && config.light_sleep_enable) {
+    Serial.println("[POWER] Auto light sleep not supported by this build, DFS only");
+    config.light_sleep_enable = false;
+    err = esp_pm_configure(&config);
+  }
+  if (err == ESP_OK) {
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cpu_boost", &cpuBoostLock);
+  }
+  if (err != ESP_OK) {
+    Serial.printf("[POWER] esp_pm unavailable (%s), using a fixed clock\n", esp_err_to_name(err));
+    cpuBoostLock = NULL;
+    return false;
+  }
+
+  cpuAutoLightSleep = config.light_sleep_enable;
+  energyModel.phaseMa[PHASE_TLS] += ENERGY_BOOST_MA;
+  energyModel.phaseMa[PHASE_PARSE] += ENERGY_BOOST_MA;
+  Serial.printf("[POWER] CPU %d MHz, %d MHz during TLS and parsing%s\n", CPU_FREQ_MHZ,
+                CPU_BOOST_FREQ_MHZ, cpuAutoLightSleep ? ", auto light sleep" : "");
+  return true;
+}
+
+// Locks are counted, so overlapping phases on both tasks nest correctly
+void setCpuBoost(bool on) {
+  if (cpuBoostLock == NULL) return;
+  if (on) {
+    esp_pm_lock_acquire(cpuBoostLock);
+  } else {
+    esp_pm_lock_release(cpuBoostLock);
+  }
+}
+
+const char* cpuPolicyName() {
+  if (cpuBoostLock == NULL) return "fixed clock";
+  return cpuAutoLightSleep ? "DFS + auto light sleep" : "DFS";
+}
+
 void configurePowerSaving() {
   Serial.println("\n[POWER] Configuring power-saving features...");
 
-  // Set CPU frequency to save power
-  setCpuFrequencyMhz(CPU_FREQ_MHZ);
-  Serial.print("[POWER] CPU frequency set to ");
-  Serial.print(CPU_FREQ_MHZ);
-  Serial.println("MHz (saves ~30mA vs 240MHz)");
+#if CPU_POLICY == CPU_POLICY_DFS
+  if (!startFrequencyScaling())
+#endif
+  {
+    // Set CPU frequency to save power
+    setCpuFrequencyMhz(CPU_FREQ_MHZ);
+    Serial.print("[POWER] CPU frequency set to ");
+    Serial.print(CPU_FREQ_MHZ);
+    Serial.println("MHz (saves ~30mA vs 240MHz)");
+  }
+
+#if SLEEP_MODE == SLEEP_MODE_LIGHT
+  Serial.println("[POWER] Light sleep between scheduled updates");
+#elif SLEEP_MODE == SLEEP_MODE_DEEP
+  Serial.println("[POWER] Deep sleep between scheduled updates (backlight off while asleep)");
+#endif
 
   Serial.println("[POWER] Power management initialized");
   Serial.println("[POWER] Display always-on mode (encased device)");
   Serial.println("[POWER] WiFi disconnects between updates to save power");
 }
 
-void checkBattery() {
-  // Read battery voltage from ADC
-  // LILYGO T-Display has voltage divider (2:1), ADC range 0-4095 for 0-3.3V
-  // Actual battery voltage = (ADC_value / 4095) * 3.3V * 2
-  int adcValue = analogRead(BATTERY_PIN);
-  batteryVoltage = (adcValue / 4095.0) * 3.3 * 2.0;
-
-  // Sanity check - LiPo batteries never exceed 4.2V when fully charged
-  if (batteryVoltage > 4.5) {
-    Serial.println("[BATTERY] ERROR: Invalid voltage reading: " + String(batteryVoltage, 2) + "V");
-    Serial.println("[BATTERY] ADC value: " + String(adcValue) + " (possible hardware issue)");
-    return;  // Ignore erroneous readings
-  }
-
-  // Ignore very low readings (< 0.5V indicates disconnected or no battery)
-  if (batteryVoltage < 0.5) {
-    batteryLow = false;
-    batteryCritical = false;
-    return;
+// ========== BACKLIGHT ==========
+/**
+ * Backlight PWM on the low-speed LEDC group clocked from RTC8M, which keeps
+ * running in light sleep (the APB clock used by ledcSetup() does not).
+ */
+void setupBacklight() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = LEDC_TIMER_8_BIT;
+  timer.timer_num = BACKLIGHT_PWM_TIMER;
+  timer.freq_hz = BACKLIGHT_PWM_FREQ;
+  timer.clk_cfg = LEDC_USE_RTC8M_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = BACKLIGHT_PIN;
+  channel.speed_mode = LEDC_LOW_SPEED_MODE;
+  channel.channel = BACKLIGHT_PWM_CHANNEL;
+  channel.timer_sel = BACKLIGHT_PWM_TIMER;
+  channel.duty = BACKLIGHT_FULL;
+  channel.hpoint = 0;
+  ledc_channel_config(&channel);
+}
+
+void setBacklight(uint8_t duty) {
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, BACKLIGHT_PWM_CHANNEL, duty);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, BACKLIGHT_PWM_CHANNEL);
+}
+
+// Averaged, eFuse-calibrated reading at the battery (the divider halves it)
+static uint16_t readBatteryMv() {
+  uint32_t sum = 0;
+  for (int i = 0; i < BATTERY_OVERSAMPLE; i++) {
+    sum += adc1_get_raw(BATTERY_ADC_CHANNEL);
   }
+  uint32_t raw = (sum + BATTERY_OVERSAMPLE / 2) / BATTERY_OVERSAMPLE;
+  return (uint16_t)(esp_adc_cal_raw_to_voltage(raw, &batteryAdcChars) * 2);
+}
 
-  // Check for critical battery level (immediate shutdown required)
-  if (batteryVoltage < BATTERY_CRITICAL_VOLTAGE) {
-    batteryCritical = true;
-    Serial.println("[BATTERY] ⚠️ CRITICAL: " + String(batteryVoltage, 2) + "V - Shutting down to prevent damage!");
-    shutdownDevice("Critical battery voltage: " + String(batteryVoltage, 2) + "V");
+// Queue the filter state for checkBattery()
+static void publishBattery() {
+  BatteryEvent event = {batteryFilterMv(batteryFilter), batteryFilter.level, batteryFilter.charging};
+  if (batteryEvents.push(event) && uiTaskHandle != NULL) {
+    xTaskNotifyGive(uiTaskHandle);
   }
-  // Check for low battery warning
-  else if (batteryVoltage < BATTERY_LOW_VOLTAGE) {
-    if (!batteryLow) {  // Only log once when transitioning to low state
-      Serial.println("[BATTERY] ⚠️ LOW: " + String(batteryVoltage, 2) + "V - Please charge soon!");
-    }
-    batteryLow = true;
-    batteryCritical = false;
+}
+
+// esp_timer task: sample and filter; loop() is only woken when something changed
+static void sampleBattery(void* arg) {
+  lastBatterySample = uptimeMs();
+  if (batteryFilterUpdate(batteryFilter, readBatteryMv(), batteryThresholds)) {
+    publishBattery();
+  }
+}
+
+void setupBatteryMonitor() {
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  adc1_config_channel_atten(BATTERY_ADC_CHANNEL, ADC_ATTEN_DB_11);
+  esp_adc_cal_value_t cal = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                                     BATTERY_ADC_DEFAULT_VREF, &batteryAdcChars);
+  Serial.printf("[BATTERY] ADC calibration: %s\n",
+                cal == ESP_ADC_CAL_VAL_EFUSE_TP ? "two-point" :
+                cal == ESP_ADC_CAL_VAL_EFUSE_VREF ? "eFuse Vref" : "default Vref");
+
+  // First sample synchronously so the state is known before anything is drawn.
+  // Always published: after a deep-sleep wake the RTC filter often has
+  // nothing new, but batteryVoltage starts from 0 in RAM again.
+  lastBatterySample = uptimeMs();
+  batteryFilterUpdate(batteryFilter, readBatteryMv(), batteryThresholds);
+  publishBattery();
+
+  if (batteryTimer == NULL) {
+    esp_timer_create_args_t args = {};
+    args.callback = sampleBattery;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "battery";
+    esp_timer_create(&args, &batteryTimer);
   }
-  // Battery OK
-  else {
-    if (batteryLow) {  // Only log when recovering from low state
-      Serial.println("[BATTERY] ✅ OK: " + String(batteryVoltage, 2) + "V - Battery recovered");
+  esp_timer_start_periodic(batteryTimer, (uint64_t)BATTERY_CHECK_INTERVAL * 1000ULL);
+}
+
+// Apply the filtered battery changes the sampler queued (UI side)
+void checkBattery() {
+  BatteryEvent event;
+  while (batteryEvents.pop(event)) {
+    batteryVoltage = event.voltageMv / 1000.0;
+    batteryMillivolts = event.voltageMv;
+    char volts[VOLTAGE_FORMAT_MAX_LEN];
+    formatMillivolts(volts, sizeof(volts), batteryMillivolts);
+
+    // Check for critical battery level (immediate shutdown required)
+    if (event.level == BATTERY_CRITICAL) {
+      batteryCritical = true;
+      Serial.printf("[BATTERY] ⚠️ CRITICAL: %s - Shutting down to prevent damage!\n", volts);
+      shutdownDevice(String("Critical battery voltage: ") + volts);
+    }
+    // Check for low battery warning
+    else if (event.level == BATTERY_LOW) {
+      if (!batteryLow) {  // Only log once when transitioning to low state
+        Serial.printf("[BATTERY] ⚠️ LOW: %s - Please charge soon!\n", volts);
+      }
+      batteryLow = true;
+      batteryCritical = false;
+    }
+    // Battery OK (or no battery on the divider)
+    else {
+      if (batteryLow && event.level == BATTERY_OK) {  // Only log when recovering from low state
+        Serial.printf("[BATTERY] ✅ OK: %s - Battery recovered\n", volts);
+      }
+      batteryLow = false;
+      batteryCritical = false;
     }
-    batteryLow = false;
-    batteryCritical = false;
+
+    // Check if device is plugged in (for battery display indicator)
+    batteryCharging = event.charging;
+    wasPluggedIn = isPluggedIn;
+    isPluggedIn = checkIfPluggedIn();
+
+    // Detect plug-in event (transition from unplugged to plugged)
+    if (isPluggedIn && !wasPluggedIn) {
+      Serial.println("\n[POWER] 🔌 Device plugged in detected!");
+      Serial.print("[POWER] Voltage: ");
+      Serial.print(batteryVoltage, 2);
+      Serial.println("V (charging)");
+    }
+
+    // Detect unplug event
+    if (!isPluggedIn && wasPluggedIn) {
+      Serial.println("\n[POWER] 🔋 Device unplugged - running on battery");
+      Serial.print("[POWER] Voltage: ");
+      Serial.print(batteryVoltage, 2);
+      Serial.println("V");
+    }
+
+    drawBatteryWarning();  // Only repaints the corner when its text changed
   }
 }
 
 // ========== PLUG-IN DETECTION ==========
 bool checkIfPluggedIn() {
   // When plugged in via USB, voltage rises above normal battery max (4.2V)
-  // Charging voltage typically reads 4.3-5.0V
-  if (batteryVoltage > BATTERY_CHARGING_VOLTAGE) {
-    return true;
-  }
-  return false;
+  // Charging voltage typically reads 4.3-5.0V; the filter applies hysteresis
+  return batteryCharging;
 }
 
 void drawBatteryWarning() {
+  uint8_t status;
+  uint8_t color;
+  const char* label;
   if (batteryCritical) {
-    // Critical: Red, blinking (will shut down)
-    tft.setTextColor(COLOR_ERROR, COLOR_BG);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString("CRITICAL", SCREEN_WIDTH - 2, 2, 1);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString(String(batteryVoltage, 2) + "V", SCREEN_WIDTH - 2, 12, 1);
+    // Critical: Red (will shut down)
+    status = STATUS_CRITICAL; color = PAL_ERROR; label = "CRITICAL";
   } else if (isPluggedIn) {
     // Plugged in: Green, show charging indicator
-    tft.setTextColor(COLOR_CHART, COLOR_BG);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString("CHARGING", SCREEN_WIDTH - 2, 2, 1);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString(String(batteryVoltage, 2) + "V", SCREEN_WIDTH - 2, 12, 1);
+    status = STATUS_CHARGING; color = PAL_CHART; label = "CHARGING";
   } else if (batteryLow) {
     // Low: Yellow/Orange warning
-    tft.setTextColor(COLOR_WARNING, COLOR_BG);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString("LOW", SCREEN_WIDTH - 2, 2, 1);
-    tft.setTextDatum(TR_DATUM);
-    tft.drawString(String(batteryVoltage, 2) + "V", SCREEN_WIDTH - 2, 12, 1);
+    status = STATUS_LOW; color = PAL_WARNING; label = "LOW";
   } else {
+    status = STATUS_NONE; color = PAL_BG; label = "";
+  }
+
+  char voltage[VOLTAGE_FORMAT_MAX_LEN];
+  formatMillivolts(voltage, sizeof(voltage), batteryMillivolts);
+
+  // Only touch the corner when what it shows has changed
+  if (statusCorner.valid && statusCorner.status == status &&
+      (status == STATUS_NONE || strcmp(voltage, statusCorner.voltage) == 0)) {
+    return;
+  }
+
+  if (status == STATUS_NONE) {
     // Clear the warning area if battery is OK
-    tft.fillRect(SCREEN_WIDTH - 50, 0, 50, 22, COLOR_BG);
+    if (!statusCorner.valid || statusCorner.status != STATUS_NONE) {
+      frame.fillRect(SCREEN_WIDTH - STATUS_CORNER_WIDTH, 0, STATUS_CORNER_WIDTH, STATUS_CORNER_HEIGHT, PAL_BG);
+      markDirty(SCREEN_WIDTH - STATUS_CORNER_WIDTH, 0, STATUS_CORNER_WIDTH, STATUS_CORNER_HEIGHT);
+    }
+  } else {
+    // Padded text overwrites the previous label without a separate clear
+    frame.setTextColor(color, PAL_BG);
+    frame.setTextDatum(TR_DATUM);
+    frame.setTextPadding(STATUS_CORNER_WIDTH);
+    frame.drawString(label, SCREEN_WIDTH - 2, 2, 1);
+    frame.drawString(voltage, SCREEN_WIDTH - 2, 12, 1);
+    frame.setTextPadding(0);
+    markDirty(SCREEN_WIDTH - STATUS_CORNER_WIDTH, 0, STATUS_CORNER_WIDTH, STATUS_CORNER_HEIGHT);
   }
+  flushDisplay();
+
+  statusCorner.status = status;
+  strlcpy(statusCorner.voltage, voltage, sizeof(statusCorner.voltage));
+  statusCorner.valid = true;
 }
 
 void shutdownDevice(const String& reason) {
@@ -878,41 +3591,45 @@ void shutdownDevice(const String& reason) {
   Serial.println("[SHUTDOWN] To restart: Press RESET button or charge battery above " + String(BATTERY_CRITICAL_VOLTAGE, 1) + "V");
 
   // Display shutdown warning
-  tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_ERROR, COLOR_BG);
-  tft.setTextDatum(MC_DATUM);
+  clearScreen();
+  frame.setTextColor(PAL_ERROR, PAL_BG);
+  frame.setTextDatum(MC_DATUM);
 
   // Main warning
-  tft.drawString("BATTERY CRITICAL", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 30, 4);
+  frame.drawString("BATTERY CRITICAL", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 30, 4);
 
   // Voltage display
-  tft.setTextColor(COLOR_TEXT, COLOR_BG);
-  tft.drawString("Voltage: " + String(batteryVoltage, 2) + "V", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
-  tft.drawString("Minimum: " + String(BATTERY_CRITICAL_VOLTAGE, 1) + "V", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
+  frame.setTextColor(PAL_TEXT, PAL_BG);
+  frame.drawString("Voltage: " + String(batteryVoltage, 2) + "V", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, 2);
+  frame.drawString("Minimum: " + String(BATTERY_CRITICAL_VOLTAGE, 1) + "V", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 20, 2);
 
   // Instructions
-  tft.setTextColor(COLOR_WARNING, COLOR_BG);
-  tft.drawString("Shutting down in 5s...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 45, 2);
+  frame.setTextColor(PAL_WARNING, PAL_BG);
+  frame.drawString("Shutting down in 5s...", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 45, 2);
+  flushDisplay();
 
   // Countdown
   for (int i = 5; i > 0; i--) {
-    tft.fillRect(0, SCREEN_HEIGHT / 2 + 65, SCREEN_WIDTH, 20, COLOR_BG);
-    tft.setTextColor(COLOR_ERROR, COLOR_BG);
-    tft.drawString(String(i), SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 65, 4);
+    frame.fillRect(0, SCREEN_HEIGHT / 2 + 65, SCREEN_WIDTH, 20, PAL_BG);
+    frame.setTextColor(PAL_ERROR, PAL_BG);
+    frame.drawString(String(i), SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 65, 4);
+    markDirty(0, SCREEN_HEIGHT / 2 + 65 - 13, SCREEN_WIDTH, 26);
+    flushDisplay();
     delay(1000);
   }
 
   // Final message
-  tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_TEXT, COLOR_BG);
-  tft.drawString("SHUTDOWN", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 15, 4);
-  tft.drawString("Charge battery", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 15, 2);
-  tft.drawString("Press RESET to restart", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 35, 2);
+  clearScreen();
+  frame.setTextColor(PAL_TEXT, PAL_BG);
+  frame.drawString("SHUTDOWN", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 - 15, 4);
+  frame.drawString("Charge battery", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 15, 2);
+  frame.drawString("Press RESET to restart", SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 35, 2);
+  flushDisplay();
 
   delay(2000);
 
   // Turn off backlight to save power
-  ledcWrite(BACKLIGHT_PWM_CHANNEL, 0);
+  setBacklight(0);
 
   Serial.println("[SHUTDOWN] Entering deep sleep mode...");
   Serial.println("[SHUTDOWN] Device will wake only on RESET button press");
@@ -0,0 +1,375 @@
+/**
+ * TLS session resumption for WiFiClientSecure
+ *
+ * Mirrors start_ssl_client() from the Arduino core, with one addition: the
+ * cached session for the host is offered before the handshake and the new
+ * session (ticket) is saved afterwards. Once connected, the inherited
+ * WiFiClientSecure read/write/stop paths operate on the same sslclient
+ * context unchanged.
+ */
+
+#include "tls_session_client.h"
+
+#include <WiFi.h>
+#include <Preferences.h>
+#include <lwip/sockets.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+
+#define TLS_NVS_NAMESPACE "tls"
+
+const uint16_t TLS_HISTOGRAM_BOUNDS_MS[TLS_HISTOGRAM_BUCKETS - 1] = {
+  50, 100, 250, 500, 1000, 2500, 5000
+};
+
+static TlsHandshakeStats stats[TLS_STATS_SLOTS];
+static size_t statsUsed = 0;
+
+// ========== HANDSHAKE STATISTICS ==========
+static TlsHandshakeStats* statsFor(const char* host) {
+  for (size_t i = 0; i < statsUsed; i++) {
+    if (strcmp(stats[i].host, host) == 0) return &stats[i];
+  }
+
+  // Reuse the last slot once the table is full
+  size_t slot = (statsUsed < TLS_STATS_SLOTS) ? statsUsed++ : TLS_STATS_SLOTS - 1;
+  memset(&stats[slot], 0, sizeof(TlsHandshakeStats));
+  strncpy(stats[slot].host, host, TLS_STATS_HOST_LEN - 1);
+  return &stats[slot];
+}
+
+static void countInBucket(uint32_t* buckets, uint32_t ms) {
+  size_t i = 0;
+  while (i < TLS_HISTOGRAM_BUCKETS - 1 && ms > TLS_HISTOGRAM_BOUNDS_MS[i]) i++;
+  buckets[i]++;
+}
+
+size_t tlsStatsCount() {
+  return statsUsed;
+}
+
+const TlsHandshakeStats* tlsStats(size_t index) {
+  return (index < statsUsed) ? &stats[index] : NULL;
+}
+
+void printTlsStats() {
+  for (size_t i = 0; i < statsUsed; i++) {
+    const TlsHandshakeStats& s = stats[i];
+    Serial.printf("[TLS] %s: full %u (avg %ums), resumed %u (avg %ums), failed %u, last %ums%s, "
+                  "TTFB avg %ums last %ums\n",
+                  s.host,
+                  s.fullCount, s.fullCount ? s.fullTotalMs / s.fullCount : 0,
+                  s.resumedCount, s.resumedCount ? s.resumedTotalMs / s.resumedCount : 0,
+                  s.failedCount, s.lastMs, s.lastResumed ? " (resumed)" : "",
+                  s.ttfbCount ? s.ttfbTotalMs / s.ttfbCount : 0, s.lastTtfbMs);
+  }
+}
+
+// ========== SESSION STORE (NVS) ==========
+#define FNV_OFFSET_BASIS 2166136261u
+
+static uint32_t fnv1a(uint32_t hash, const unsigned char* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// NVS keys are limited to 15 characters, so hosts are keyed by FNV-1a hash
+static void sessionKey(const char* host, char* key, size_t keyLen) {
+  uint32_t hash = fnv1a(FNV_OFFSET_BASIS, (const unsigned char*)host, strlen(host));
+  snprintf(key, keyLen, "s%08x", hash);
+}
+
+// What a resumed handshake can renew: the session ID and the ticket
+static uint32_t sessionFingerprint(const mbedtls_ssl_session& session) {
+  uint32_t hash = fnv1a(FNV_OFFSET_BASIS, session.id, session.id_len);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  hash = fnv1a(hash, session.ticket, session.ticket_len);
+#endif
+  return hash;
+}
+
+void forgetTlsSessions() {
+  Preferences prefs;
+  prefs.begin(TLS_NVS_NAMESPACE, false);
+  prefs.clear();
+  prefs.end();
+}
+
+bool TlsSessionClient::restoreSession(const char* host) {
+  _sessionOffered = false;
+  char key[16];
+  sessionKey(host, key, sizeof(key));
+
+  Preferences prefs;
+  prefs.begin(TLS_NVS_NAMESPACE, true);
+  size_t len = prefs.getBytesLength(key);
+  if (len == 0 || len > TLS_SESSION_MAX_SIZE) {
+    prefs.end();
+    return false;
+  }
+
+  unsigned char* buf = (unsigned char*)malloc(len);
+  if (!buf) {
+    prefs.end();
+    return false;
+  }
+  prefs.getBytes(key, buf, len);
+  prefs.end();
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  bool ok = (mbedtls_ssl_session_load(&session, buf, len) == 0) &&
+            (mbedtls_ssl_set_session(&sslclient->ssl_ctx, &session) == 0);
+  if (ok) {
+    _sessionOffered = true;
+    _offeredFingerprint = sessionFingerprint(session);
+  }
+  mbedtls_ssl_session_free(&session);
+  free(buf);
+
+  if (!ok) {
+    // Stale format (e.g. after a firmware update) - drop it
+    prefs.begin(TLS_NVS_NAMESPACE, false);
+    prefs.remove(key);
+    prefs.end();
+  }
+  return ok;
+}
+
+// Only written when the server handed out a new session ID or ticket; a
+// resumption that kept the stored one would rewrite ~2.5 KB of flash for nothing
+void TlsSessionClient::saveSession(const char* host) {
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  if (mbedtls_ssl_get_session(&sslclient->ssl_ctx, &session) != 0 ||
+      (_sessionOffered && sessionFingerprint(session) == _offeredFingerprint)) {
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+
+  unsigned char* buf = (unsigned char*)malloc(TLS_SESSION_MAX_SIZE);
+  size_t len = 0;
+  if (buf && mbedtls_ssl_session_save(&session, buf, TLS_SESSION_MAX_SIZE, &len) == 0) {
+    char key[16];
+    sessionKey(host, key, sizeof(key));
+
+    Preferences prefs;
+    prefs.begin(TLS_NVS_NAMESPACE, false);
+    prefs.putBytes(key, buf, len);
+    prefs.end();
+  }
+  free(buf);
+  mbedtls_ssl_session_free(&session);
+}
+
+// ========== CONNECT ==========
+static bool waitSocket(int fd, bool forRead, bool forWrite, int32_t timeoutMs) {
+  if (timeoutMs < 0) timeoutMs = 0;
+
+  fd_set readSet, writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &readSet);
+  FD_SET(fd, &writeSet);
+
+  struct timeval tv;
+  tv.tv_sec = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+  return select(fd + 1, forRead ? &readSet : NULL, forWrite ? &writeSet : NULL, NULL, &tv) > 0;
+}
+
+int TlsSessionClient::handshakeSend(void* ctx, const unsigned char* buf, size_t len) {
+  TlsSessionClient* self = (TlsSessionClient*)ctx;
+  return mbedtls_net_send(&self->sslclient->socket, buf, len);
+}
+
+int TlsSessionClient::handshakeRecv(void* ctx, unsigned char* buf, size_t len) {
+  TlsSessionClient* self = (TlsSessionClient*)ctx;
+  int ret = mbedtls_net_recv(&self->sslclient->socket, buf, len);
+  if (ret > 0) self->_handshakeRxBytes += ret;
+  return ret;
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  return WiFiClientSecure::connect(ip, port);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, TLS_CONNECT_TIMEOUT_MS);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port, int32_t timeout) {
+  // Certificate verification still goes through the stock path
+  if (!_use_insecure) {
+    return WiFiClientSecure::connect(host, port, timeout);
+  }
+
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    Serial.printf("[TLS] DNS lookup failed for %s\n", host);
+    return 0;
+  }
+
+  if (_connected) stop();
+
+  unsigned long start = millis();
+  int ret = openTls(ip, port, host, timeout);
+  unsigned long elapsed = millis() - start;
+
+  TlsHandshakeStats* s = statsFor(host);
+  s->lastMs = elapsed;
+  if (ret < 0) {
+    s->failedCount++;
+    _lastError = ret;
+    Serial.printf("[TLS] Handshake with %s failed (%d)\n", host, ret);
+    stop();
+    return 0;
+  }
+
+  s->lastResumed = _resumed;
+  if (_resumed) {
+    s->resumedCount++;
+    s->resumedTotalMs += elapsed;
+  } else {
+    s->fullCount++;
+    s->fullTotalMs += elapsed;
+  }
+  countInBucket(s->handshakeBuckets, elapsed);
+  Serial.printf("[TLS] %s handshake with %s in %lums\n", _resumed ? "Resumed" : "Full", host, elapsed);
+
+  saveSession(host);
+  _stats = s;
+  _awaitingFirstByte = false;
+  _connected = true;
+  return 1;
+}
+
+// ========== RESPONSE WAIT ==========
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  size_t n = WiFiClientSecure::write(buf, size);
+  _requestSentMs = millis();
+  _awaitingFirstByte = true;
+  _lastTtfbMs = 0;
+  return n;
+}
+
+// First data after a request write, however it is seen: waited for, or already buffered
+void TlsSessionClient::noteFirstByte() {
+  if (!_awaitingFirstByte) return;
+  _awaitingFirstByte = false;
+  _lastTtfbMs = millis() - _requestSentMs;
+  if (_stats) {
+    _stats->ttfbCount++;
+    _stats->ttfbTotalMs += _lastTtfbMs;
+    _stats->lastTtfbMs = _lastTtfbMs;
+    countInBucket(_stats->ttfbBuckets, _lastTtfbMs);
+  }
+}
+
+int TlsSessionClient::available() {
+  int n = WiFiClientSecure::available();
+  if (n > 0) noteFirstByte();
+  return n;
+}
+
+int TlsSessionClient::read() {
+  int c = WiFiClientSecure::read();
+  if (c >= 0) noteFirstByte();
+  return c;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  int n = WiFiClientSecure::read(buf, size);
+  if (n > 0) noteFirstByte();
+  return n;
+}
+
+bool TlsSessionClient::waitReadable(int32_t timeoutMs) {
+  unsigned long start = millis();
+
+  for (;;) {
+    if (available() > 0) return true;  // Records the first byte, see noteFirstByte()
+    if (!connected()) return false;
+
+    int32_t remaining = timeoutMs - (int32_t)(millis() - start);
+    if (remaining <= 0) return false;
+
+    // Readable may be a partial TLS record; available() above pulls it into
+    // mbedTLS, so the next select() blocks until more ciphertext arrives
+    waitSocket(sslclient->socket, true, false, remaining);
+  }
+}
+
+int TlsSessionClient::openTls(const IPAddress& ip, uint16_t port, const char* host, int32_t timeoutMs) {
+  sslclient_context* ctx = sslclient;
+  unsigned long start = millis();
+
+  mbedtls_ssl_init(&ctx->ssl_ctx);
+  mbedtls_ssl_config_init(&ctx->ssl_conf);
+  mbedtls_ctr_drbg_init(&ctx->drbg_ctx);
+  mbedtls_entropy_init(&ctx->entropy_ctx);
+
+  // Non-blocking TCP connect bounded by select()
+  ctx->socket = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (ctx->socket < 0) return -1;
+  fcntl(ctx->socket, F_SETFL, fcntl(ctx->socket, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  addr.sin_port = htons(port);
+
+  int res = lwip_connect(ctx->socket, (struct sockaddr*)&addr, sizeof(addr));
+  if (res < 0 && errno != EINPROGRESS) return -1;
+  if (!waitSocket(ctx->socket, false, true, timeoutMs)) return -1;
+
+  int sockErr = 0;
+  socklen_t errLen = sizeof(sockErr);
+  getsockopt(ctx->socket, SOL_SOCKET, SO_ERROR, &sockErr, &errLen);
+  if (sockErr != 0) return -1;
+
+  int enable = 1;
+  setsockopt(ctx->socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  setsockopt(ctx->socket, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+
+  const char* pers = "esp32-tls";
+  int ret = mbedtls_ctr_drbg_seed(&ctx->drbg_ctx, mbedtls_entropy_func, &ctx->entropy_ctx,
+                                  (const unsigned char*)pers, strlen(pers));
+  if (ret != 0) return ret;
+
+  ret = mbedtls_ssl_config_defaults(&ctx->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) return ret;
+
+  mbedtls_ssl_conf_authmode(&ctx->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);  // setInsecure()
+  mbedtls_ssl_conf_rng(&ctx->ssl_conf, mbedtls_ctr_drbg_random, &ctx->drbg_ctx);
+  mbedtls_ssl_conf_session_tickets(&ctx->ssl_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+  if ((ret = mbedtls_ssl_setup(&ctx->ssl_ctx, &ctx->ssl_conf)) != 0) return ret;
+  if ((ret = mbedtls_ssl_set_hostname(&ctx->ssl_ctx, host)) != 0) return ret;
+
+  bool offered = restoreSession(host);
+
+  // Count handshake bytes: a resumed handshake never receives the certificate chain
+  _handshakeRxBytes = 0;
+  mbedtls_ssl_set_bio(&ctx->ssl_ctx, this, handshakeSend, handshakeRecv, NULL);
+
+  while ((ret = mbedtls_ssl_handshake(&ctx->ssl_ctx)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) return ret;
+
+    int32_t remaining = timeoutMs - (int32_t)(millis() - start);
+    if (remaining <= 0) return -1;
+    waitSocket(ctx->socket, ret == MBEDTLS_ERR_SSL_WANT_READ, ret == MBEDTLS_ERR_SSL_WANT_WRITE, remaining);
+  }
+
+  _resumed = offered && _handshakeRxBytes < TLS_RESUMED_MAX_BYTES;
+
+  // Hand the socket back to the stock callbacks used by WiFiClientSecure
+  mbedtls_ssl_set_bio(&ctx->ssl_ctx, &ctx->socket, mbedtls_net_send, mbedtls_net_recv, NULL);
+  return ctx->socket;
+}
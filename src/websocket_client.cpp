@@ -0,0 +1,183 @@
+#include "websocket_client.h"
+
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+#include <esp_system.h>
+#include "http_response.h"
+
+#define WS_ACCEPT_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_KEY_LEN     24   // Base64 of 16 random bytes
+
+WebSocketClient::WebSocketClient(TlsSessionClient& client, uint8_t* messageBuffer, size_t capacity)
+    : _client(client), _decoder(messageBuffer, capacity), _rxPos(0), _rxLen(0) {
+}
+
+// Sec-WebSocket-Accept the server must send back for `key` (RFC 6455 4.2.2)
+static bool expectedAccept(const char* key, char* out, size_t outLen) {
+  char material[WS_KEY_LEN + sizeof(WS_ACCEPT_GUID)];
+  snprintf(material, sizeof(material), "%s%s", key, WS_ACCEPT_GUID);
+
+  uint8_t digest[20];
+  if (mbedtls_sha1_ret((const uint8_t*)material, strlen(material), digest) != 0) return false;
+  size_t written = 0;
+  return mbedtls_base64_encode((uint8_t*)out, outLen, &written, digest, sizeof(digest)) == 0;
+}
+
+bool WebSocketClient::connect(const char* host, const char* path) {
+  _decoder.reset();
+  _rxPos = _rxLen = 0;
+
+  if (!_client.connect(host, 443)) return false;
+  if (!upgrade(host, path)) {
+    _client.stop();
+    return false;
+  }
+  return true;
+}
+
+bool WebSocketClient::upgrade(const char* host, const char* path) {
+  uint8_t nonce[16];
+  esp_fill_random(nonce, sizeof(nonce));
+  char key[WS_KEY_LEN + 1];
+  size_t keyLen = 0;
+  mbedtls_base64_encode((uint8_t*)key, sizeof(key), &keyLen, nonce, sizeof(nonce));
+
+  char request[320];
+  snprintf(request, sizeof(request),
+           "GET %s HTTP/1.1\r\n"
+           "Host: %s\r\n"
+           "Upgrade: websocket\r\n"
+           "Connection: Upgrade\r\n"
+           "Sec-WebSocket-Key: %s\r\n"
+           "Sec-WebSocket-Version: 13\r\n\r\n",
+           path, host, key);
+  _client.print(request);
+
+  HttpResponseHead head;
+  if (!readHead(head) || head.status != 101) {
+    Serial.printf("[WS] Upgrade refused by %s (HTTP %d)\n", host, head.status);
+    return false;
+  }
+
+  char accept[HTTP_WS_ACCEPT_MAX_LEN];
+  if (!expectedAccept(key, accept, sizeof(accept)) || strcmp(accept, head.webSocketAccept) != 0) {
+    Serial.printf("[WS] Bad Sec-WebSocket-Accept from %s\n", host);
+    return false;
+  }
+  return true;
+}
+
+// The 101 head is read through _rx itself, so frames the server sent right
+// behind it stay in _rx[_rxPos.._rxLen) for poll() however much arrived
+bool WebSocketClient::readHead(HttpResponseHead& head) {
+  httpResetHead(head);
+  unsigned long start = millis();
+
+  char line[WS_HEADER_LINE_MAX];
+  size_t lineLen = 0;
+  bool truncated = false;
+
+  for (;;) {
+    if (_rxPos >= _rxLen) {
+      int n = _client.read(_rx, sizeof(_rx));
+      if (n > 0) {
+        _rxPos = 0;
+        _rxLen = n;
+        continue;
+      }
+      if (!_client.connected()) return false;
+      int32_t remaining = WS_HANDSHAKE_TIMEOUT_MS - (int32_t)(millis() - start);
+      if (remaining <= 0) return false;
+      _client.waitReadable(remaining);
+      continue;
+    }
+
+    char c = (char)_rx[_rxPos++];
+    if (c != '\n') {
+      if (lineLen < sizeof(line) - 1) {
+        line[lineLen++] = c;
+      } else {
+        truncated = true;
+      }
+      continue;
+    }
+
+    if (lineLen > 0 && line[lineLen - 1] == '\r') lineLen--;
+    line[lineLen] = '\0';
+    if (!truncated || head.status == 0) {
+      if (!httpParseHeadLine(head, line)) break;
+    }
+    lineLen = 0;
+    truncated = false;
+  }
+  return head.status > 0;
+}
+
+bool WebSocketClient::sendFrame(uint8_t opcode, const uint8_t* payload, size_t len) {
+  uint8_t frame[WS_TX_BUFFER_SIZE];
+  size_t n = webSocketEncodeFrame(frame, sizeof(frame), opcode, payload, len, esp_random());
+  if (n == 0) return false;
+  // Only data frames expect an answer worth timing; PONG/CLOSE must not re-arm TTFB
+  size_t sent = opcode >= WS_OP_CLOSE ? _client.writeUntimed(frame, n) : _client.write(frame, n);
+  return sent == n;
+}
+
+bool WebSocketClient::sendText(const char* text) {
+  return sendFrame(WS_OP_TEXT, (const uint8_t*)text, strlen(text));
+}
+
+WebSocketPoll WebSocketClient::poll(int32_t timeoutMs) {
+  unsigned long start = millis();
+
+  for (;;) {
+    while (_rxPos < _rxLen) {
+      WebSocketEvent event;
+      _rxPos += _decoder.feed(_rx + _rxPos, _rxLen - _rxPos, event);
+
+      if (event == WS_EVENT_MESSAGE) {
+        if (_decoder.messageTruncated()) {
+          Serial.println("[WS] Skipped a message larger than the buffer");
+          continue;
+        }
+        return WS_POLL_MESSAGE;
+      }
+      if (event == WS_EVENT_CONTROL) {
+        if (_decoder.controlOpcode() == WS_OP_PING) {
+          sendFrame(WS_OP_PONG, _decoder.controlPayload(), _decoder.controlLength());
+        } else if (_decoder.controlOpcode() == WS_OP_CLOSE) {
+          sendFrame(WS_OP_CLOSE, _decoder.controlPayload(), min(_decoder.controlLength(), (size_t)2));
+          _client.stop();
+          return WS_POLL_CLOSED;
+        }
+        continue;
+      }
+      if (event == WS_EVENT_ERROR) {
+        Serial.println("[WS] Protocol error, closing");
+        close();
+        return WS_POLL_CLOSED;
+      }
+    }
+
+    int n = _client.read(_rx, sizeof(_rx));
+    if (n > 0) {
+      _rxPos = 0;
+      _rxLen = n;
+      continue;
+    }
+    if (!_client.connected()) return WS_POLL_CLOSED;
+
+    int32_t remaining = timeoutMs - (int32_t)(millis() - start);
+    if (remaining <= 0) return WS_POLL_TIMEOUT;
+    _client.waitReadable(remaining);
+  }
+}
+
+void WebSocketClient::close() {
+  if (_client.connected()) {
+    const uint8_t normal[2] = { 0x03, 0xE8 };  // 1000 normal closure
+    sendFrame(WS_OP_CLOSE, normal, sizeof(normal));
+  }
+  _client.stop();
+  _decoder.reset();
+  _rxPos = _rxLen = 0;
+}
@@ -0,0 +1,166 @@
+/**
+ * Host-side microbenchmarks for the hot parsing and formatting paths
+ *
+ *   pio test -e native -f test_bench -v
+ *
+ * Each benchmark reports ns/op and heap allocations per op, counted by
+ * replacing the global operator new (lib/core never calls malloc). Every
+ * path here must stay allocation-free, so an allocation fails the test;
+ * the timings are informational, to compare against the last run before
+ * a rollout.
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "backoff.h"
+#include "chunked_decoder.h"
+#include "glyph_atlas.h"
+#include "http_response.h"
+#include "price_format.h"
+#include "semver.h"
+
+#define BENCH_ITERATIONS 200000
+
+// ========== ALLOCATION COUNTING ==========
+static size_t allocationCount = 0;
+
+void* operator new(size_t size) {
+  allocationCount++;
+  void* p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// ========== HARNESS ==========
+static volatile uint32_t sink;  // Keeps the optimizer from dropping the work
+
+template <typename Fn>
+static void bench(const char* name, Fn fn) {
+  for (int i = 0; i < 1000; i++) fn(i);  // Warm up caches and branch predictors
+
+  size_t allocationsBefore = allocationCount;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) fn(i);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  size_t allocations = allocationCount - allocationsBefore;
+
+  double nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / BENCH_ITERATIONS;
+  char line[128];
+  snprintf(line, sizeof(line), "%-24s %9.1f ns/op %8.3f allocs/op", name, nsPerOp,
+           (double)allocations / BENCH_ITERATIONS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_size_t(0, allocations);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ========== BENCHMARKS ==========
+static void bench_format_price() {
+  char text[PRICE_FORMAT_MAX_LEN];
+  bench("formatPriceWithCommas", [&](int i) {
+    sink += formatPriceWithCommas(text, sizeof(text), 60000.0f + i);
+  });
+}
+
+static void bench_format_voltage() {
+  char text[VOLTAGE_FORMAT_MAX_LEN];
+  bench("formatMillivolts", [&](int i) {
+    sink += formatMillivolts(text, sizeof(text), (uint16_t)(3000 + (i & 1023)));
+  });
+}
+
+static void bench_compare_version() {
+  static const char* const tags[] = {"1.3.1", "1.10.0", "2.0.0-rc1", "1.3"};
+  bench("compareSemanticVersion", [&](int i) {
+    sink += compareSemanticVersion("1.3.1", tags[i & 3]);
+  });
+}
+
+static void bench_backoff() {
+  bench("backoffDelayMs", [&](int i) {
+    sink += backoffDelayMs((i & 7) + 1, 5000, 60000, (uint32_t)i * 2654435761u);
+  });
+}
+
+static void bench_chunked_decode() {
+  static const char raw[] =
+    "19\r\n{\"bitcoin\":{\"usd\":67012.3\r\n"
+    "4;ext\r\n4}}\n\r\n"
+    "0\r\n\r\n";
+  uint8_t buf[sizeof(raw)];
+  ChunkedDecoder decoder;
+  bench("ChunkedDecoder::decode", [&](int) {
+    memcpy(buf, raw, sizeof(raw) - 1);
+    decoder.reset();
+    sink += decoder.decode(buf, sizeof(raw) - 1);
+  });
+  TEST_ASSERT_TRUE(decoder.finished());
+}
+
+static void bench_parse_head() {
+  static const char* const lines[] = {
+    "HTTP/1.1 200 OK",
+    "Date: Sun, 06 Nov 1994 08:49:37 GMT",
+    "Content-Type: application/json; charset=utf-8",
+    "Transfer-Encoding: chunked",
+    "Connection: close",
+    "ETag: W/\"6e2b8a32dbb1c0b7a76f6c0d8b1b1e5c\"",
+    "Cache-Control: max-age=30",
+    "",
+  };
+  HttpResponseHead head;
+  bench("httpParseHeadLine x8", [&](int) {
+    httpResetHead(head);
+    for (const char* line : lines) {
+      if (!httpParseHeadLine(head, line)) break;
+    }
+    sink += head.status;
+  });
+}
+
+static void bench_parse_date() {
+  uint32_t t = 0;
+  bench("httpParseDate", [&](int) {
+    httpParseDate("Sun, 06 Nov 1994 08:49:37 GMT", t);
+    sink += t;
+  });
+}
+
+// One font 6 sized digit (28 x 48) painted into a 240 x 135 4-bit frame
+static void bench_glyph_draw() {
+  static GlyphAtlas atlas;
+  static uint8_t fb[240 * 135 / 2];
+  for (size_t i = 0; i < sizeof(fb); i++) fb[i] = (uint8_t)(i * 37);
+  glyphAtlasReset(atlas, 48);
+  glyphAtlasCapture(atlas, '8', fb, 240, 135, 0, 0, 28, 1);
+  const GlyphInfo* glyph = glyphAtlasFind(atlas, '8');
+
+  bench("glyphAtlasDraw", [&](int i) {
+    glyphAtlasDraw(atlas, *glyph, fb, 240, 135, 40 + (i & 2), 43, 1, 0);
+    sink += fb[1000];
+  });
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(bench_format_price);
+  RUN_TEST(bench_format_voltage);
+  RUN_TEST(bench_compare_version);
+  RUN_TEST(bench_backoff);
+  RUN_TEST(bench_chunked_decode);
+  RUN_TEST(bench_parse_head);
+  RUN_TEST(bench_parse_date);
+  RUN_TEST(bench_glyph_draw);
+  return UNITY_END();
+}
@@ -0,0 +1,870 @@
+/**
+ * Host-side unit tests for the hardware-independent code in lib/core
+ *
+ *   pio test -e native -f test_core
+ */
+
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+
+#include "backoff.h"
+#include "battery_filter.h"
+#include "chunked_decoder.h"
+#include "energy_log.h"
+#include "firmware_image.h"
+#include "glyph_atlas.h"
+#include "http_response.h"
+#include "memory_watermark.h"
+#include "price_format.h"
+#include "price_history.h"
+#include "refresh_policy.h"
+#include "rollout.h"
+#include "semver.h"
+#include "source_health.h"
+#include "spsc_queue.h"
+#include "websocket_frame.h"
+
+void setUp() {}
+void tearDown() {}
+
+// ========== BATTERY FILTER ==========
+static const BatteryThresholds BATTERY_T = {500, 3000, 3500, 3600, 4300, 4200, 4500};
+
+// Feed `mv` until the filter has settled on it
+static void settleBattery(BatteryFilter& f, uint16_t mv) {
+  for (int i = 0; i < 64; i++) batteryFilterUpdate(f, mv, BATTERY_T);
+}
+
+static void test_battery_charging_hysteresis() {
+  BatteryFilter f;
+  batteryFilterReset(f);
+  settleBattery(f, 4100);
+  TEST_ASSERT_FALSE(f.charging);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_OK, f.level);
+
+  settleBattery(f, 4300);            // At the threshold, not above it
+  TEST_ASSERT_FALSE(f.charging);
+  settleBattery(f, 4350);
+  TEST_ASSERT_TRUE(f.charging);
+  settleBattery(f, 4250);            // Inside the band: still charging
+  TEST_ASSERT_TRUE(f.charging);
+  settleBattery(f, 4150);
+  TEST_ASSERT_FALSE(f.charging);
+}
+
+static void test_battery_low_hysteresis() {
+  BatteryFilter f;
+  batteryFilterReset(f);
+  settleBattery(f, 3700);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_OK, f.level);
+
+  settleBattery(f, 3450);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_LOW, f.level);
+  settleBattery(f, 3550);            // Recovered past LOW, not past the clear level
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_LOW, f.level);
+  settleBattery(f, 3650);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_OK, f.level);
+
+  settleBattery(f, 2900);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_CRITICAL, f.level);
+  batteryFilterReset(f);
+  settleBattery(f, 100);
+  TEST_ASSERT_EQUAL_UINT8(BATTERY_ABSENT, f.level);
+}
+
+static void test_battery_out_of_range_is_external_power() {
+  BatteryFilter f;
+  batteryFilterReset(f);
+  settleBattery(f, 4000);
+  uint16_t cellMv = batteryFilterMv(f);
+
+  // USB rail on the divider: reported once, and the cell voltage is untouched
+  TEST_ASSERT_TRUE(batteryFilterUpdate(f, 5000, BATTERY_T));
+  TEST_ASSERT_TRUE(f.charging);
+  TEST_ASSERT_FALSE(batteryFilterUpdate(f, 4900, BATTERY_T));
+  TEST_ASSERT_EQUAL_UINT16(cellMv, batteryFilterMv(f));
+
+  // Unplugged: the next cell reading is below the clear level
+  TEST_ASSERT_TRUE(batteryFilterUpdate(f, 4000, BATTERY_T));
+  TEST_ASSERT_FALSE(f.charging);
+
+  // Powered up on USB with no valid reading yet
+  batteryFilterReset(f);
+  TEST_ASSERT_TRUE(batteryFilterUpdate(f, 5000, BATTERY_T));
+  TEST_ASSERT_TRUE(f.charging);
+  TEST_ASSERT_FALSE(f.primed);
+}
+
+// ========== CHUNKED DECODER ==========
+// Decode `raw` fed in pieces of `step` bytes; returns the body ("" on failure)
+static const char* decodeInSteps(const char* raw, size_t step, ChunkedDecoder& decoder) {
+  static char body[256];
+  uint8_t piece[64];
+  size_t bodyLen = 0;
+  size_t len = strlen(raw);
+
+  decoder.reset();
+  for (size_t i = 0; i < len; i += step) {
+    size_t n = (len - i < step) ? len - i : step;
+    memcpy(piece, raw + i, n);
+    size_t out = decoder.decode(piece, n);
+    memcpy(body + bodyLen, piece, out);
+    bodyLen += out;
+  }
+  body[bodyLen] = '\0';
+  return body;
+}
+
+static void test_chunked_single_chunk() {
+  ChunkedDecoder d;
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1}", decodeInSteps("7\r\n{\"a\":1}\r\n0\r\n\r\n", 64, d));
+  TEST_ASSERT_TRUE(d.finished());
+}
+
+static void test_chunked_any_split() {
+  const char* raw = "4\r\nWiki\r\n5;ext=1\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\nX-Trailer: 1\r\n\r\n";
+  for (size_t step = 1; step <= 16; step++) {
+    ChunkedDecoder d;
+    TEST_ASSERT_EQUAL_STRING("Wikipedia in\r\n\r\nchunks.", decodeInSteps(raw, step, d));
+    TEST_ASSERT_TRUE(d.finished());
+  }
+}
+
+static void test_chunked_bare_lf_and_hex_case() {
+  ChunkedDecoder d;
+  TEST_ASSERT_EQUAL_STRING("0123456789", decodeInSteps("a\n0123456789\n0\n\n", 3, d));
+  TEST_ASSERT_TRUE(d.finished());
+}
+
+static void test_chunked_rejects_bad_size() {
+  ChunkedDecoder d;
+  decodeInSteps("zz\r\nabc\r\n0\r\n\r\n", 64, d);
+  TEST_ASSERT_TRUE(d.failed());
+
+  decodeInSteps("\r\nabc", 64, d);  // No digits at all
+  TEST_ASSERT_TRUE(d.failed());
+
+  decodeInSteps("FFFFFFFF\r\n", 64, d);  // Larger than any body we accept
+  TEST_ASSERT_TRUE(d.failed());
+}
+
+// ========== HTTP RESPONSE HEAD ==========
+static void parseHead(HttpResponseHead& head, const char* const* lines) {
+  httpResetHead(head);
+  for (; *lines; lines++) {
+    if (!httpParseHeadLine(head, *lines)) break;
+  }
+}
+
+static void test_head_fields() {
+  const char* lines[] = {
+    "HTTP/1.1 200 OK",
+    "content-type: application/json",
+    "Transfer-Encoding: gzip, Chunked",
+    "ETag:   W/\"abc\"  ",
+    "Date: Sun, 06 Nov 1994 08:49:37 GMT",
+    "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+    "",
+    NULL
+  };
+  HttpResponseHead head;
+  parseHead(head, lines);
+  TEST_ASSERT_EQUAL_INT(200, head.status);
+  TEST_ASSERT_TRUE(head.chunked);
+  TEST_ASSERT_EQUAL_STRING("W/\"abc\"", head.etag);
+  TEST_ASSERT_EQUAL_STRING("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", head.webSocketAccept);
+  TEST_ASSERT_EQUAL_INT32(-1, head.contentLength);
+}
+
+static void test_head_content_length() {
+  HttpResponseHead head;
+  const char* ok[] = {"HTTP/1.1 200 OK", "Content-Length: 1234 ", NULL};
+  parseHead(head, ok);
+  TEST_ASSERT_EQUAL_INT32(1234, head.contentLength);
+
+  const char* overflow[] = {"HTTP/1.1 200 OK", "Content-Length: 99999999999", NULL};
+  parseHead(head, overflow);
+  TEST_ASSERT_EQUAL_INT32(-1, head.contentLength);
+
+  const char* junk[] = {"HTTP/1.1 200 OK", "Content-Length: 12x", NULL};
+  parseHead(head, junk);
+  TEST_ASSERT_EQUAL_INT32(-1, head.contentLength);
+}
+
+static void test_head_malformed_status() {
+  HttpResponseHead head;
+  const char* lines[] = {"ICY 200 OK", NULL};
+  parseHead(head, lines);
+  TEST_ASSERT_EQUAL_INT(-1, head.status);
+}
+
+static void test_head_oversized_etag_dropped() {
+  char line[HTTP_ETAG_MAX_LEN + 16] = "ETag: ";
+  memset(line + 6, 'x', HTTP_ETAG_MAX_LEN);
+  line[6 + HTTP_ETAG_MAX_LEN] = '\0';
+  const char* lines[] = {"HTTP/1.1 200 OK", line, NULL};
+  HttpResponseHead head;
+  parseHead(head, lines);
+  TEST_ASSERT_EQUAL_STRING("", head.etag);
+}
+
+static void test_http_date() {
+  uint32_t t;
+  TEST_ASSERT_TRUE(httpParseDate("Sun, 06 Nov 1994 08:49:37 GMT", t));
+  TEST_ASSERT_EQUAL_UINT32(784111777u, t);
+  TEST_ASSERT_TRUE(httpParseDate("Thu, 29 Feb 2024 00:00:00 GMT", t));
+  TEST_ASSERT_EQUAL_UINT32(1709164800u, t);
+
+  TEST_ASSERT_FALSE(httpParseDate("Sunday, 06-Nov-94 08:49:37 GMT", t));
+  TEST_ASSERT_FALSE(httpParseDate("Sun Nov  6 08:49:37 1994", t));
+  TEST_ASSERT_FALSE(httpParseDate("Sun, 06 Foo 1994 08:49:37 GMT", t));
+}
+
+static void test_retry_after() {
+  HttpResponseHead head;
+  uint32_t seconds;
+
+  const char* delta[] = {"HTTP/1.1 429 Too Many Requests", "Retry-After: 120", NULL};
+  parseHead(head, delta);
+  TEST_ASSERT_TRUE(httpRetryAfterSeconds(head, seconds));
+  TEST_ASSERT_EQUAL_UINT32(120, seconds);
+
+  const char* date[] = {
+    "HTTP/1.1 503 Service Unavailable",
+    "Date: Sun, 06 Nov 1994 08:49:37 GMT",
+    "Retry-After: Sun, 06 Nov 1994 08:52:07 GMT",
+    NULL
+  };
+  parseHead(head, date);
+  TEST_ASSERT_TRUE(httpRetryAfterSeconds(head, seconds));
+  TEST_ASSERT_EQUAL_UINT32(150, seconds);
+
+  const char* none[] = {"HTTP/1.1 429 Too Many Requests", NULL};
+  parseHead(head, none);
+  TEST_ASSERT_FALSE(httpRetryAfterSeconds(head, seconds));
+}
+
+// ========== SEMANTIC VERSION ==========
+static void test_semver_compare() {
+  TEST_ASSERT_EQUAL_INT(0, compareSemanticVersion("1.2.3", "1.2.3"));
+  TEST_ASSERT_EQUAL_INT(-1, compareSemanticVersion("1.2.0", "1.10.0"));
+  TEST_ASSERT_EQUAL_INT(1, compareSemanticVersion("2.0.0", "1.99.99"));
+  TEST_ASSERT_EQUAL_INT(-1, compareSemanticVersion("1.3.1", "1.3.2"));
+  TEST_ASSERT_EQUAL_INT(1, compareSemanticVersion("1.3.10", "1.3.9"));
+}
+
+static void test_semver_partial_and_suffix() {
+  TEST_ASSERT_EQUAL_INT(0, compareSemanticVersion("1", "1.0.0"));
+  TEST_ASSERT_EQUAL_INT(0, compareSemanticVersion("1.4", "1.4.0"));
+  TEST_ASSERT_EQUAL_INT(0, compareSemanticVersion("1.2.3-beta", "1.2.3"));
+  TEST_ASSERT_EQUAL_INT(-1, compareSemanticVersion("", "0.0.1"));
+
+  static_assert(parseSemanticVersion("1.3.1").minor == 3, "parse must be constexpr");
+
+  SemanticVersion v = parseSemanticVersion("10.20.30");
+  TEST_ASSERT_EQUAL_INT(10, v.major);
+  TEST_ASSERT_EQUAL_INT(20, v.minor);
+  TEST_ASSERT_EQUAL_INT(30, v.patch);
+}
+
+static void test_semver_well_formed() {
+  static_assert(semverWellFormed("1.3.1"), "check must be constexpr");
+  TEST_ASSERT_TRUE(semverWellFormed("0.0.0"));
+  TEST_ASSERT_TRUE(semverWellFormed("10.20.30"));
+  TEST_ASSERT_TRUE(semverWellFormed("1.2.3-beta"));
+  TEST_ASSERT_TRUE(semverWellFormed("1.2.3+build.7"));
+  TEST_ASSERT_FALSE(semverWellFormed(""));
+  TEST_ASSERT_FALSE(semverWellFormed("1.2"));
+  TEST_ASSERT_FALSE(semverWellFormed("1..3"));
+  TEST_ASSERT_FALSE(semverWellFormed("v1.2.3"));
+  TEST_ASSERT_FALSE(semverWellFormed("1.2.3.4"));
+  TEST_ASSERT_FALSE(semverWellFormed("1.2.x"));
+}
+
+// ========== PRICE FORMAT ==========
+static void test_price_grouping() {
+  char text[PRICE_FORMAT_MAX_LEN];
+  const struct { float price; const char* expected; } cases[] = {
+    {0.0f, "$0"}, {7.99f, "$7"}, {999.0f, "$999"}, {1000.0f, "$1,000"},
+    {67012.34f, "$67,012"}, {123456.0f, "$123,456"}, {1234567.0f, "$1,234,567"},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    TEST_ASSERT_EQUAL_size_t(strlen(cases[i].expected), formatPriceWithCommas(text, sizeof(text), cases[i].price));
+    TEST_ASSERT_EQUAL_STRING(cases[i].expected, text);
+  }
+}
+
+static void test_price_edge_values() {
+  char text[PRICE_FORMAT_MAX_LEN];
+  formatPriceWithCommas(text, sizeof(text), -5.0f);
+  TEST_ASSERT_EQUAL_STRING("$0", text);
+  formatPriceWithCommas(text, sizeof(text), NAN);
+  TEST_ASSERT_EQUAL_STRING("$0", text);
+  formatPriceWithCommas(text, sizeof(text), 1e12f);
+  TEST_ASSERT_EQUAL_STRING("$4,294,967,295", text);
+}
+
+static void test_price_buffer_too_small() {
+  char text[6];
+  TEST_ASSERT_EQUAL_size_t(0, formatPriceWithCommas(text, sizeof(text), 67012.0f));
+  TEST_ASSERT_EQUAL_STRING("", text);
+  TEST_ASSERT_EQUAL_size_t(5, formatGroupedInteger(text, sizeof(text), 1000));
+  TEST_ASSERT_EQUAL_STRING("1,000", text);
+}
+
+static void test_voltage_format() {
+  char text[VOLTAGE_FORMAT_MAX_LEN];
+  TEST_ASSERT_EQUAL_size_t(5, formatMillivolts(text, sizeof(text), 3874));
+  TEST_ASSERT_EQUAL_STRING("3.87V", text);
+  formatMillivolts(text, sizeof(text), 4195);
+  TEST_ASSERT_EQUAL_STRING("4.20V", text);
+  formatMillivolts(text, sizeof(text), 0);
+  TEST_ASSERT_EQUAL_STRING("0.00V", text);
+  formatMillivolts(text, sizeof(text), 65535);
+  TEST_ASSERT_EQUAL_STRING("65.54V", text);
+
+  char small[5];
+  TEST_ASSERT_EQUAL_size_t(0, formatMillivolts(small, sizeof(small), 3700));
+  TEST_ASSERT_EQUAL_STRING("", small);
+}
+
+static void test_age_format() {
+  char text[AGE_FORMAT_MAX_LEN];
+  TEST_ASSERT_EQUAL_size_t(2, formatAge(text, sizeof(text), 0));
+  TEST_ASSERT_EQUAL_STRING("0s", text);
+  formatAge(text, sizeof(text), 59);
+  TEST_ASSERT_EQUAL_STRING("59s", text);
+  formatAge(text, sizeof(text), 3599);
+  TEST_ASSERT_EQUAL_STRING("59m", text);
+  formatAge(text, sizeof(text), 7200);
+  TEST_ASSERT_EQUAL_STRING("2h", text);
+  formatAge(text, sizeof(text), 86400 * 3 + 5);
+  TEST_ASSERT_EQUAL_STRING("3d", text);
+  TEST_ASSERT_EQUAL_size_t(6, formatAge(text, sizeof(text), UINT32_MAX));
+  TEST_ASSERT_EQUAL_STRING("49710d", text);
+
+  char small[3];
+  TEST_ASSERT_EQUAL_size_t(0, formatAge(small, sizeof(small), 1200));
+  TEST_ASSERT_EQUAL_STRING("", small);
+}
+
+// ========== BACKOFF ==========
+static void test_backoff_schedule() {
+  // Entropy 0 is the low end of the jitter: 80% of the nominal delay
+  TEST_ASSERT_EQUAL_INT32(0, backoffDelayMs(0, 5000, 60000, 0));
+  TEST_ASSERT_EQUAL_INT32(4000, backoffDelayMs(1, 5000, 60000, 0));
+  TEST_ASSERT_EQUAL_INT32(8000, backoffDelayMs(2, 5000, 60000, 0));
+  TEST_ASSERT_EQUAL_INT32(16000, backoffDelayMs(3, 5000, 60000, 0));
+  TEST_ASSERT_EQUAL_INT32(48000, backoffDelayMs(5, 5000, 60000, 0));
+  TEST_ASSERT_EQUAL_INT32(48000, backoffDelayMs(1000, 5000, 60000, 0));  // No shift overflow
+}
+
+static void test_backoff_jitter_bounds() {
+  for (uint32_t entropy = 0; entropy < 50000; entropy += 7) {
+    int32_t d = backoffDelayMs(1, 5000, 60000, entropy);
+    TEST_ASSERT_TRUE(d >= 4000 && d < 6000);
+  }
+  TEST_ASSERT_EQUAL_INT32(5999, backoffDelayMs(1, 5000, 60000, 1999));
+  TEST_ASSERT_EQUAL_INT32(4, backoffDelayMs(1, 4, 60000, 12345));  // Too small to jitter
+}
+
+// ========== WEBSOCKET FRAMES ==========
+// Feed `len` bytes in pieces of `step`, collecting events in order
+static size_t feedAll(WebSocketDecoder& d, const uint8_t* data, size_t len, size_t step,
+                      WebSocketEvent* events, size_t maxEvents) {
+  size_t count = 0;
+  size_t pos = 0;
+  while (pos < len && !d.failed()) {
+    size_t piece = (len - pos < step) ? len - pos : step;
+    size_t used = 0;
+    while (used < piece && !d.failed()) {
+      WebSocketEvent event;
+      used += d.feed(data + pos + used, piece - used, event);
+      if (event != WS_EVENT_NONE && count < maxEvents) events[count++] = event;
+    }
+    pos += piece;
+  }
+  return count;
+}
+
+static void test_websocket_text_any_split() {
+  const uint8_t frame[] = { 0x81, 0x05, 'h', 'e', 'l', 'l', 'o' };
+  for (size_t step = 1; step <= sizeof(frame); step++) {
+    uint8_t buf[16];
+    WebSocketDecoder d(buf, sizeof(buf));
+    WebSocketEvent events[4];
+    TEST_ASSERT_EQUAL_UINT32(1, feedAll(d, frame, sizeof(frame), step, events, 4));
+    TEST_ASSERT_EQUAL_INT(WS_EVENT_MESSAGE, events[0]);
+    TEST_ASSERT_EQUAL_INT(WS_OP_TEXT, d.messageOpcode());
+    TEST_ASSERT_EQUAL_UINT32(5, d.messageLength());
+    TEST_ASSERT_EQUAL_INT(0, memcmp("hello", d.message(), 5));
+  }
+}
+
+static void test_websocket_fragments_with_ping() {
+  const uint8_t frames[] = {
+    0x01, 0x03, 'a', 'b', 'c',    // Text, not final
+    0x89, 0x01, 'p',              // Ping in between
+    0x80, 0x02, 'd', 'e'          // Final continuation
+  };
+  uint8_t buf[16];
+  WebSocketDecoder d(buf, sizeof(buf));
+  WebSocketEvent event;
+  size_t used = d.feed(frames, sizeof(frames), event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_CONTROL, event);
+  TEST_ASSERT_EQUAL_INT(WS_OP_PING, d.controlOpcode());
+  TEST_ASSERT_EQUAL_UINT32(1, d.controlLength());
+
+  used += d.feed(frames + used, sizeof(frames) - used, event);
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_MESSAGE, event);
+  TEST_ASSERT_EQUAL_UINT32(sizeof(frames), used);
+  TEST_ASSERT_EQUAL_UINT32(5, d.messageLength());
+  TEST_ASSERT_EQUAL_INT(0, memcmp("abcde", d.message(), 5));
+}
+
+static void test_websocket_extended_length_and_truncation() {
+  uint8_t frame[4 + 300];
+  frame[0] = 0x82;
+  frame[1] = 126;
+  frame[2] = 300 >> 8;
+  frame[3] = 300 & 0xFF;
+  memset(frame + 4, 'x', 300);
+
+  uint8_t big[400];
+  WebSocketDecoder fits(big, sizeof(big));
+  WebSocketEvent events[2];
+  TEST_ASSERT_EQUAL_UINT32(1, feedAll(fits, frame, sizeof(frame), 7, events, 2));
+  TEST_ASSERT_EQUAL_UINT32(300, fits.messageLength());
+  TEST_ASSERT_FALSE(fits.messageTruncated());
+
+  uint8_t small[64];
+  WebSocketDecoder skips(small, sizeof(small));
+  TEST_ASSERT_EQUAL_UINT32(1, feedAll(skips, frame, sizeof(frame), 7, events, 2));
+  TEST_ASSERT_EQUAL_INT(WS_EVENT_MESSAGE, events[0]);
+  TEST_ASSERT_TRUE(skips.messageTruncated());
+
+  // Still in step for the next frame
+  const uint8_t next[] = { 0x81, 0x01, 'z' };
+  TEST_ASSERT_EQUAL_UINT32(1, feedAll(skips, next, sizeof(next), 1, events, 2));
+  TEST_ASSERT_FALSE(skips.messageTruncated());
+  TEST_ASSERT_EQUAL_UINT32(1, skips.messageLength());
+}
+
+static void test_websocket_protocol_errors() {
+  const uint8_t masked[] = { 0x81, 0x81, 0, 0, 0, 0, 'a' };
+  const uint8_t longPing[] = { 0x89, 126, 0, 200 };
+  const uint8_t strayContinuation[] = { 0x80, 0x00 };
+  const uint8_t reserved[] = { 0x83, 0x00 };
+  const uint8_t* cases[] = { masked, longPing, strayContinuation, reserved };
+  const size_t lens[] = { sizeof(masked), sizeof(longPing), sizeof(strayContinuation), sizeof(reserved) };
+
+  for (size_t c = 0; c < 4; c++) {
+    uint8_t buf[16];
+    WebSocketDecoder d(buf, sizeof(buf));
+    WebSocketEvent events[2];
+    TEST_ASSERT_EQUAL_UINT32(1, feedAll(d, cases[c], lens[c], 1, events, 2));
+    TEST_ASSERT_EQUAL_INT(WS_EVENT_ERROR, events[0]);
+    TEST_ASSERT_TRUE(d.failed());
+  }
+}
+
+static void test_websocket_encode_masked() {
+  uint8_t out[16];
+  const uint8_t payload[] = { 'H', 'i' };
+  size_t n = webSocketEncodeFrame(out, sizeof(out), WS_OP_TEXT, payload, 2, 0x01020304);
+  const uint8_t expected[] = { 0x81, 0x82, 1, 2, 3, 4, 'H' ^ 1, 'i' ^ 2 };
+  TEST_ASSERT_EQUAL_UINT32(sizeof(expected), n);
+  TEST_ASSERT_EQUAL_INT(0, memcmp(expected, out, n));
+  TEST_ASSERT_EQUAL_UINT32(0, webSocketEncodeFrame(out, 7, WS_OP_TEXT, payload, 2, 0));
+
+  uint8_t large[200 + WS_CLIENT_HEADER_MAX];
+  uint8_t body[200] = {};
+  n = webSocketEncodeFrame(large, sizeof(large), WS_OP_BINARY, body, sizeof(body), 0);
+  TEST_ASSERT_EQUAL_UINT32(2 + 2 + 4 + 200, n);
+  TEST_ASSERT_EQUAL_UINT8(0x80 | 126, large[1]);
+  TEST_ASSERT_EQUAL_UINT8(200, large[3]);
+}
+
+// ========== MEMORY WATERMARKS ==========
+static void test_heap_fragmentation() {
+  TEST_ASSERT_EQUAL_UINT8(0, heapFragmentation(0, 0));
+  TEST_ASSERT_EQUAL_UINT8(0, heapFragmentation(100000, 100000));
+  TEST_ASSERT_EQUAL_UINT8(75, heapFragmentation(100000, 25000));
+  TEST_ASSERT_EQUAL_UINT8(0, heapFragmentation(1000, 4000));  // Sampled at different instants
+}
+
+static void test_memory_peaks_per_phase() {
+  MemoryWatermarks w;
+  memoryReset(w);
+  memoryRecord(w, MEM_PHASE_TLS, 120000, 60000);
+  memoryRecord(w, MEM_PHASE_TLS, 90000, 70000);
+  memoryRecord(w, MEM_PHASE_PARSE, 150000, 140000);
+  memoryRecord(w, MEM_PHASE_COUNT, 1, 1);  // Ignored
+
+  TEST_ASSERT_EQUAL_UINT32(2, w.phase[MEM_PHASE_TLS].samples);
+  TEST_ASSERT_EQUAL_UINT32(90000, w.phase[MEM_PHASE_TLS].minFree);
+  TEST_ASSERT_EQUAL_UINT32(60000, w.phase[MEM_PHASE_TLS].minLargestBlock);
+  TEST_ASSERT_EQUAL_UINT8(50, w.phase[MEM_PHASE_TLS].maxFragmentation);
+  TEST_ASSERT_EQUAL_UINT32(140000, w.phase[MEM_PHASE_PARSE].minLargestBlock);
+  TEST_ASSERT_EQUAL_UINT32(0, w.phase[MEM_PHASE_IDLE].samples);
+  TEST_ASSERT_EQUAL_STRING("ota", memoryPhaseName(MEM_PHASE_OTA));
+}
+
+// ========== ENERGY LOG ==========
+static void test_phase_timer_long_phase() {
+  PhaseTimer t;
+  phaseReset(t);
+  const uint64_t start = 5000000000ULL;          // Past 2^32 µs of uptime already
+  const uint64_t threeHoursUs = 3ULL * 3600 * 1000000;
+
+  phaseBegin(t, PHASE_SESSION, start);
+  phaseEnd(t, PHASE_SESSION, start + threeHoursUs);
+  TEST_ASSERT_TRUE(t.totalUs[PHASE_SESSION] == threeHoursUs);
+
+  phaseEnd(t, PHASE_SESSION, start + 2 * threeHoursUs);   // Not running: no-op
+  TEST_ASSERT_TRUE(t.totalUs[PHASE_SESSION] == threeHoursUs);
+}
+
+static void test_energy_close_long_session() {
+  PhaseTimer network, ui;
+  phaseReset(network);
+  phaseReset(ui);
+  const uint64_t hourUs = 3600ULL * 1000000;
+  phaseBegin(network, PHASE_SESSION, 0);
+  phaseEnd(network, PHASE_SESSION, 2 * hourUs);   // A two-hour stream session
+  phaseBegin(network, PHASE_TLS, 0);
+  phaseEnd(network, PHASE_TLS, 500000);
+
+  EnergyModel model = {};
+  model.phaseMa[PHASE_TLS] = 100;
+  model.phaseMa[PHASE_SESSION] = 80;
+  WakeEnergy record;
+  energyClose(record, network, ui, model, 7200, 7200000, 0, 4000);
+
+  TEST_ASSERT_EQUAL_UINT32(7200000, record.phaseMs[PHASE_SESSION]);
+  TEST_ASSERT_EQUAL_UINT32(500, record.phaseMs[PHASE_TLS]);
+  // 0.5 s at 100 mA + 7199.5 s at 80 mA = 576.01 C
+  TEST_ASSERT_EQUAL_UINT32(576010000, record.chargeUc);
+  TEST_ASSERT_EQUAL_UINT32(160003, energyMicroAmpHours(record));
+}
+
+// ========== REFRESH POLICY ==========
+static void test_refresh_interval_table() {
+  const RefreshPolicy p = {300000, 21600000, 86400000, 60000, 3900, 3500, 100, 300};
+  struct {
+    bool plugged;
+    uint16_t mv;
+    uint32_t moveBp;
+    uint32_t expectMs;
+  } const cases[] = {
+    {true,  4000, 0,   300000},     // USB
+    {true,  4000, 500, 75000},      // USB, quartered
+    {true,  4000, 2000, 75000},
+    {false, 4100, 0,   21600000},   // Healthy cell
+    {false, 3900, 0,   21600000},   // Stretch starts below 3.9 V
+    {false, 3700, 0,   54000000},   // Halfway: 6 h + 18 h / 2
+    {false, 3500, 0,   86400000},   // At the low threshold
+    {false, 3200, 0,   86400000},
+    {false, 4100, 99,  21600000},   // Just under the mid move
+    {false, 4100, 100, 10800000},   // Halved
+    {false, 4100, 300, 5400000},    // Quartered
+    {false, 3200, 300, 21600000},
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    TEST_ASSERT_EQUAL_UINT32(cases[i].expectMs,
+                             refreshIntervalMs(p, cases[i].plugged, cases[i].mv, cases[i].moveBp));
+  }
+
+  // The floor applies after the divisor
+  const RefreshPolicy fast = {120000, 21600000, 86400000, 60000, 3900, 3500, 100, 300};
+  TEST_ASSERT_EQUAL_UINT32(60000, refreshIntervalMs(fast, true, 0, 300));
+}
+
+// ========== SOURCE HEALTH ==========
+static void test_source_demotion_and_recovery() {
+  SourceHealth health[3] = {};
+  uint8_t order[3];
+
+  // Untried sources keep table order; measured ones sort by latency
+  TEST_ASSERT_EQUAL_UINT(3, rankSources(health, 3, 1000, order));
+  TEST_ASSERT_EQUAL_UINT8(0, order[0]);
+  sourceRecordSuccess(health[0], 800);
+  sourceRecordSuccess(health[1], 300);
+  sourceRecordSuccess(health[2], 500);
+  rankSources(health, 3, 1000, order);
+  TEST_ASSERT_EQUAL_UINT8(1, order[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, order[1]);
+  TEST_ASSERT_EQUAL_UINT8(0, order[2]);
+
+  // A failure parks the fastest source for the base backoff, then doubles it
+  sourceRecordFailure(health[1], 1000, 0);
+  TEST_ASSERT_FALSE(sourceAvailable(health[1], 1000 + SOURCE_BACKOFF_BASE_MS - 1));
+  TEST_ASSERT_EQUAL_UINT(2, rankSources(health, 3, 2000, order));
+  TEST_ASSERT_EQUAL_UINT8(2, order[0]);
+  TEST_ASSERT_TRUE(sourceAvailable(health[1], 1000 + SOURCE_BACKOFF_BASE_MS));
+  sourceRecordFailure(health[1], 400000, 0);
+  TEST_ASSERT_FALSE(sourceAvailable(health[1], 400000 + 2 * SOURCE_BACKOFF_BASE_MS - 1));
+  TEST_ASSERT_TRUE(sourceAvailable(health[1], 400000 + 2 * SOURCE_BACKOFF_BASE_MS));
+
+  // Back from backoff it ranks behind a clean source until successes decay its score
+  uint32_t later = 2000000;
+  rankSources(health, 3, later, order);
+  TEST_ASSERT_EQUAL_UINT8(2, order[0]);
+  for (int i = 0; i < 8; i++) sourceRecordSuccess(health[1], 300);
+  TEST_ASSERT_EQUAL_UINT8(0, health[1].consecutiveFailures);
+  rankSources(health, 3, later, order);
+  TEST_ASSERT_EQUAL_UINT8(1, order[0]);
+
+  // Retry-After parks for exactly the requested time, even below the base backoff
+  sourceRecordRetryAfter(health[2], later, 30000);
+  TEST_ASSERT_FALSE(sourceAvailable(health[2], later + 29999));
+  TEST_ASSERT_TRUE(sourceAvailable(health[2], later + 30000));
+
+  // A minimum backoff longer than the exponential one wins
+  sourceRecordFailure(health[0], later, 2 * SOURCE_BACKOFF_MAX_MS);
+  TEST_ASSERT_FALSE(sourceAvailable(health[0], later + SOURCE_BACKOFF_MAX_MS));
+}
+
+// ========== PRICE HISTORY ==========
+static void test_history_recent_move() {
+  static PriceHistory h;
+  historyReset(h, 7 * 86400);
+  TEST_ASSERT_EQUAL_UINT32(0, historyRecentMoveBp(h, 3600));
+
+  const uint32_t t0 = 1700000000;
+  TEST_ASSERT_TRUE(historyPush(h, t0, 5000000));              // $50,000
+  TEST_ASSERT_EQUAL_UINT32(0, historyRecentMoveBp(h, 3600));
+  TEST_ASSERT_FALSE(historyPush(h, t0, 5100000));             // Not newer: dropped
+
+  TEST_ASSERT_TRUE(historyPush(h, t0 + 7000, 4000000));       // Outside a 1 h window
+  TEST_ASSERT_TRUE(historyPush(h, t0 + 9000, 4900000));
+  TEST_ASSERT_TRUE(historyPush(h, t0 + 10800, 5000000));
+  // Last hour: 49,000..50,000 = 2% of 50,000
+  TEST_ASSERT_EQUAL_UINT32(200, historyRecentMoveBp(h, 3600));
+  // Last 3 h includes the 40,000 low: 20%
+  TEST_ASSERT_EQUAL_UINT32(2000, historyRecentMoveBp(h, 3 * 3600));
+
+  // Battery refreshes land just over 6 h apart: the previous one still counts
+  historyReset(h, 7 * 86400);
+  TEST_ASSERT_TRUE(historyPush(h, t0, 5000000));
+  TEST_ASSERT_TRUE(historyPush(h, t0 + 21610, 5100000));
+  TEST_ASSERT_EQUAL_UINT32(196, historyRecentMoveBp(h, 21600));  // 1,000 of 51,000
+  TEST_ASSERT_TRUE(historyPush(h, t0 + 2 * 21610, 5100000));
+  TEST_ASSERT_EQUAL_UINT32(0, historyRecentMoveBp(h, 21600));    // Only the previous one
+}
+
+// ========== SPSC QUEUE ==========
+static void test_spsc_queue_wraps() {
+  SpscQueue<uint32_t, 4> q;
+  uint32_t item;
+  TEST_ASSERT_TRUE(q.empty());
+  TEST_ASSERT_FALSE(q.pop(item));
+
+  // N slots hold N - 1 items
+  TEST_ASSERT_TRUE(q.push(1));
+  TEST_ASSERT_TRUE(q.push(2));
+  TEST_ASSERT_TRUE(q.push(3));
+  TEST_ASSERT_FALSE(q.push(4));
+
+  // Many laps around the ring keep FIFO order
+  uint32_t next = 1;
+  uint32_t pushed = 3;
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_TRUE(q.pop(item));
+    TEST_ASSERT_EQUAL_UINT32(next++, item);
+    TEST_ASSERT_TRUE(q.push(++pushed));
+  }
+  while (q.pop(item)) TEST_ASSERT_EQUAL_UINT32(next++, item);
+  TEST_ASSERT_EQUAL_UINT32(pushed + 1, next);
+  TEST_ASSERT_TRUE(q.empty());
+}
+
+// ========== FIRMWARE IMAGE ==========
+static bool readFake(void* ctx, uint32_t offset, void* buf, size_t len) {
+  const uint8_t* image = (const uint8_t*)ctx;
+  if (offset + len > 256) return false;
+  memcpy(buf, image + offset, len);
+  return true;
+}
+
+// Header plus two segments of 10 and 20 bytes
+static void buildFakeImage(uint8_t* image, bool hashAppended) {
+  memset(image, 0, 256);
+  image[0] = FIRMWARE_IMAGE_MAGIC;
+  image[1] = 2;
+  image[23] = hashAppended ? 1 : 0;
+  image[24 + 4] = 10;
+  image[24 + 8 + 10 + 4] = 20;
+}
+
+static void test_firmware_image_length() {
+  uint8_t image[256];
+  uint32_t length = 0;
+
+  // 24 + (8 + 10) + (8 + 20) = 70, +1 checksum padded to 80
+  buildFakeImage(image, false);
+  TEST_ASSERT_TRUE(firmwareImageLength(readFake, image, 256, length));
+  TEST_ASSERT_EQUAL_UINT32(80, length);
+
+  buildFakeImage(image, true);
+  TEST_ASSERT_TRUE(firmwareImageLength(readFake, image, 256, length));
+  TEST_ASSERT_EQUAL_UINT32(112, length);
+  TEST_ASSERT_FALSE(firmwareImageLength(readFake, image, 100, length));  // Runs past the partition
+
+  image[0] = 0xFF;  // Erased flash
+  TEST_ASSERT_FALSE(firmwareImageLength(readFake, image, 256, length));
+
+  buildFakeImage(image, false);
+  image[24 + 4 + 3] = 0x7F;  // Absurd segment length
+  TEST_ASSERT_FALSE(firmwareImageLength(readFake, image, 256, length));
+}
+
+static void test_sha256_hex_round_trip() {
+  const char* hex = "9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08";
+  uint8_t digest[SHA256_DIGEST_LEN];
+  char text[SHA256_HEX_LEN + 1];
+
+  TEST_ASSERT_TRUE(parseSha256Hex(hex, digest));
+  TEST_ASSERT_EQUAL_HEX8(0x9f, digest[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x08, digest[31]);
+  formatSha256Hex(digest, text);
+  TEST_ASSERT_EQUAL_STRING(hex, text);
+
+  TEST_ASSERT_TRUE(parseSha256Hex("sha256:9F86D081884C7D659A2FEAA0C55AD015A3BF4F1B2B0B822CD15D6C15B0F00A08", digest));
+  TEST_ASSERT_EQUAL_HEX8(0x9f, digest[0]);
+  TEST_ASSERT_TRUE(parseSha256Hex("9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08  firmware.bin\n", digest));
+
+  TEST_ASSERT_FALSE(parseSha256Hex("sha256:9f86d0", digest));
+  TEST_ASSERT_FALSE(parseSha256Hex("9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08ab", digest));
+  TEST_ASSERT_FALSE(parseSha256Hex("", digest));
+}
+
+// ========== ROLLOUT SLOTS ==========
+static void test_rollout_slot_spread() {
+  const uint32_t period = 86400;
+  uint32_t perSlot[24] = {};
+  uint8_t mac[6] = { 0x24, 0x0a, 0xc4, 0x12, 0x00, 0x00 };
+
+  // Consecutive MACs from one batch still cover every slot
+  for (int i = 0; i < 480; i++) {
+    mac[4] = (uint8_t)(i >> 8);
+    mac[5] = (uint8_t)i;
+    RolloutSlot s = rolloutSlot(mac, sizeof(mac), period, 24);
+    TEST_ASSERT_TRUE(s.slot < 24);
+    TEST_ASSERT_TRUE(s.offsetS >= s.slot * 3600 && s.offsetS < (s.slot + 1) * 3600);
+    perSlot[s.slot]++;
+  }
+  for (int i = 0; i < 24; i++) TEST_ASSERT_TRUE(perSlot[i] > 0);
+
+  RolloutSlot a = rolloutSlot(mac, sizeof(mac), period, 24);
+  RolloutSlot b = rolloutSlot(mac, sizeof(mac), period, 24);
+  TEST_ASSERT_EQUAL_UINT32(a.offsetS, b.offsetS);
+  TEST_ASSERT_EQUAL_UINT32(0, rolloutSlot(mac, sizeof(mac), period, 0).slot);
+}
+
+static void test_seconds_until_slot() {
+  // 1000 s into the day, slot at 5000 s
+  TEST_ASSERT_EQUAL_UINT32(4000, secondsUntilSlot(86400 * 3 + 1000, 86400, 5000, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, secondsUntilSlot(5000, 86400, 5000, 0));
+  // At least half a day away: today's slot is too close, take tomorrow's
+  TEST_ASSERT_EQUAL_UINT32(86400 + 4000, secondsUntilSlot(1000, 86400, 5000, 43200));
+  TEST_ASSERT_EQUAL_UINT32(86400, secondsUntilSlot(5000, 86400, 5000, 43200));
+  TEST_ASSERT_EQUAL_UINT32(60, secondsUntilSlot(123, 0, 5000, 60));
+}
+
+// ========== GLYPH ATLAS ==========
+#define FB_W 16
+#define FB_H 8
+
+static uint8_t fbPixel(const uint8_t* fb, int x, int y) {
+  uint8_t b = fb[(y * FB_W + x) / 2];
+  return (x & 1) ? (b & 0x0F) : (b >> 4);
+}
+
+static void test_glyph_capture_and_draw() {
+  static GlyphAtlas atlas;
+  uint8_t src[FB_W * FB_H / 2];
+  memset(src, 0, sizeof(src));
+  // 5-pixel-wide glyph at x 2: ink (1) on the diagonal, background 0 elsewhere
+  for (int i = 0; i < 5; i++) {
+    uint8_t& b = src[(i * FB_W + 2 + i) / 2];
+    b |= ((2 + i) & 1) ? 0x01 : 0x10;
+  }
+
+  glyphAtlasReset(atlas, 5);
+  TEST_ASSERT_TRUE(glyphAtlasCapture(atlas, '7', src, FB_W, FB_H, 2, 0, 5, 1));
+  TEST_ASSERT_FALSE(glyphAtlasCapture(atlas, '8', src, FB_W, FB_H, 14, 0, 5, 1));  // Off the right edge
+  const GlyphInfo* g = glyphAtlasFind(atlas, '7');
+  TEST_ASSERT_NOT_NULL(g);
+  TEST_ASSERT_NULL(glyphAtlasFind(atlas, '8'));
+
+  // Even (fast path) and odd x, other colors; neighbours must survive
+  for (int x = 4; x <= 5; x++) {
+    uint8_t dst[FB_W * FB_H / 2];
+    memset(dst, 0x99, sizeof(dst));
+    glyphAtlasDraw(atlas, *g, dst, FB_W, FB_H, x, 1, 0xA, 0x3);
+    for (int row = 0; row < FB_H; row++) {
+      for (int col = 0; col < FB_W; col++) {
+        uint8_t expect = 0x9;
+        if (row >= 1 && row < 6 && col >= x && col < x + 5) expect = (col - x == row - 1) ? 0xA : 0x3;
+        TEST_ASSERT_EQUAL_UINT8(expect, fbPixel(dst, col, row));
+      }
+    }
+  }
+
+  // Clipped at the bottom-right corner
+  uint8_t dst[FB_W * FB_H / 2];
+  memset(dst, 0, sizeof(dst));
+  glyphAtlasDraw(atlas, *g, dst, FB_W, FB_H, 13, 5, 0xF, 0x2);
+  TEST_ASSERT_EQUAL_UINT8(0xF, fbPixel(dst, 13, 5));
+  TEST_ASSERT_EQUAL_UINT8(0x2, fbPixel(dst, 14, 7));
+  TEST_ASSERT_EQUAL_UINT8(0xF, fbPixel(dst, 15, 7));
+  TEST_ASSERT_EQUAL_UINT8(0x0, fbPixel(dst, 12, 5));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_chunked_single_chunk);
+  RUN_TEST(test_chunked_any_split);
+  RUN_TEST(test_chunked_bare_lf_and_hex_case);
+  RUN_TEST(test_chunked_rejects_bad_size);
+  RUN_TEST(test_head_fields);
+  RUN_TEST(test_head_content_length);
+  RUN_TEST(test_head_malformed_status);
+  RUN_TEST(test_head_oversized_etag_dropped);
+  RUN_TEST(test_http_date);
+  RUN_TEST(test_retry_after);
+  RUN_TEST(test_semver_compare);
+  RUN_TEST(test_semver_partial_and_suffix);
+  RUN_TEST(test_semver_well_formed);
+  RUN_TEST(test_price_grouping);
+  RUN_TEST(test_price_edge_values);
+  RUN_TEST(test_price_buffer_too_small);
+  RUN_TEST(test_voltage_format);
+  RUN_TEST(test_age_format);
+  RUN_TEST(test_battery_charging_hysteresis);
+  RUN_TEST(test_battery_low_hysteresis);
+  RUN_TEST(test_battery_out_of_range_is_external_power);
+  RUN_TEST(test_backoff_schedule);
+  RUN_TEST(test_backoff_jitter_bounds);
+  RUN_TEST(test_websocket_text_any_split);
+  RUN_TEST(test_websocket_fragments_with_ping);
+  RUN_TEST(test_websocket_extended_length_and_truncation);
+  RUN_TEST(test_websocket_protocol_errors);
+  RUN_TEST(test_websocket_encode_masked);
+  RUN_TEST(test_heap_fragmentation);
+  RUN_TEST(test_memory_peaks_per_phase);
+  RUN_TEST(test_refresh_interval_table);
+  RUN_TEST(test_source_demotion_and_recovery);
+  RUN_TEST(test_history_recent_move);
+  RUN_TEST(test_spsc_queue_wraps);
+  RUN_TEST(test_phase_timer_long_phase);
+  RUN_TEST(test_energy_close_long_session);
+  RUN_TEST(test_firmware_image_length);
+  RUN_TEST(test_sha256_hex_round_trip);
+  RUN_TEST(test_glyph_capture_and_draw);
+  RUN_TEST(test_rollout_slot_spread);
+  RUN_TEST(test_seconds_until_slot);
+  return UNITY_END();
+}
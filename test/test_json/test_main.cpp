@@ -0,0 +1,114 @@
+/**
+ * Host-side checks of the JSON arena budgets against the real ArduinoJson
+ *
+ *   pio test -e native -f test_json
+ *
+ * Each test parses a captured payload the way src/main.cpp does, through
+ * a JsonArena of the size the firmware uses, and fails if the document
+ * runs out of memory. The peak is printed so a library upgrade that grows
+ * it shows up before it reaches a board.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_arena.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void reportPeak(const char* name, size_t peak, size_t capacity) {
+  char line[80];
+  snprintf(line, sizeof(line), "%s: peak %u of %u bytes", name, (unsigned)peak, (unsigned)capacity);
+  TEST_MESSAGE(line);
+}
+
+// ========== PRICE STREAM ==========
+// Same filter as runPriceStream()
+static void buildTickFilter(JsonDocument& filter) {
+  filter["type"] = true;
+  filter["product_id"] = true;
+  filter["price"] = true;
+  filter["message"] = true;
+}
+
+// Captured from ws-feed.exchange.coinbase.com
+static const char TICKER_FRAME[] =
+    "{\"type\":\"ticker\",\"sequence\":87261367119,\"product_id\":\"BTC-USD\","
+    "\"price\":\"67012.34\",\"open_24h\":\"66210.01\",\"volume_24h\":\"12345.67891234\","
+    "\"low_24h\":\"65800\",\"high_24h\":\"67350.5\",\"volume_30d\":\"412345.12345678\","
+    "\"best_bid\":\"67012.33\",\"best_bid_size\":\"0.01234567\",\"best_ask\":\"67012.34\","
+    "\"best_ask_size\":\"0.25000000\",\"side\":\"buy\",\"time\":\"2024-10-14T12:00:00.123456Z\","
+    "\"trade_id\":712345678,\"last_size\":\"0.00012345\"}";
+
+static const char SUBSCRIPTIONS_FRAME[] =
+    "{\"type\":\"subscriptions\",\"channels\":[{\"name\":\"ticker\","
+    "\"product_ids\":[\"BTC-USD\"],\"account_ids\":null}]}";
+
+void test_ticker_fits_stream_arena() {
+  static JsonArena<PRICE_STREAM_JSON_ARENA_SIZE> arena;
+  JsonDocument filter;
+  buildTickFilter(filter);
+
+  // Several frames through one arena, as the feed loop does
+  for (int i = 0; i < 3; i++) {
+    JsonDocument doc(&arena);
+    DeserializationError error =
+        deserializeJson(doc, TICKER_FRAME, strlen(TICKER_FRAME), DeserializationOption::Filter(filter));
+    TEST_ASSERT_EQUAL_STRING("Ok", error.c_str());
+    TEST_ASSERT_EQUAL_STRING("ticker", doc["type"] | "");
+    TEST_ASSERT_EQUAL_STRING("BTC-USD", doc["product_id"] | "");
+    TEST_ASSERT_EQUAL_STRING("67012.34", doc["price"] | "");
+    TEST_ASSERT_FALSE(doc["sequence"].is<long long>());  // Filtered out
+  }
+  TEST_ASSERT_EQUAL(0, arena.used());
+  reportPeak("ticker", arena.peak(), arena.capacity());
+}
+
+void test_subscriptions_ack_fits_stream_arena() {
+  static JsonArena<PRICE_STREAM_JSON_ARENA_SIZE> arena;
+  JsonDocument filter;
+  buildTickFilter(filter);
+
+  JsonDocument doc(&arena);
+  DeserializationError error = deserializeJson(doc, SUBSCRIPTIONS_FRAME, strlen(SUBSCRIPTIONS_FRAME),
+                                               DeserializationOption::Filter(filter));
+  TEST_ASSERT_EQUAL_STRING("Ok", error.c_str());
+  TEST_ASSERT_EQUAL_STRING("subscriptions", doc["type"] | "");
+  TEST_ASSERT_NULL(doc["price"].as<const char*>());
+  reportPeak("subscriptions", arena.peak(), arena.capacity());
+}
+
+// ========== HISTORY BACKFILL ==========
+// market_chart "prices" elements, parsed one at a time into a reused document
+static const char* const HISTORY_POINTS[] = {
+  "[1728864000000,62784.51230148577]",
+  "[1728867600000, 62901.0856287943]",
+  "[1728907200000,67012.34]",
+};
+
+void test_history_points_fit_history_arena() {
+  static JsonArena<HISTORY_JSON_ARENA_SIZE> arena;
+  JsonDocument point(&arena);
+
+  for (size_t i = 0; i < sizeof(HISTORY_POINTS) / sizeof(HISTORY_POINTS[0]); i++) {
+    DeserializationError error = deserializeJson(point, HISTORY_POINTS[i]);
+    TEST_ASSERT_EQUAL_STRING("Ok", error.c_str());
+    TEST_ASSERT_EQUAL(2, point.size());
+    TEST_ASSERT_TRUE(point[0].as<double>() > 1.7e12);
+    TEST_ASSERT_TRUE(point[1].as<float>() > 60000.0f);
+    point.clear();
+    TEST_ASSERT_EQUAL(0, arena.used());
+  }
+  reportPeak("history point", arena.peak(), arena.capacity());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ticker_fits_stream_arena);
+  RUN_TEST(test_subscriptions_ack_fits_stream_arena);
+  RUN_TEST(test_history_points_fit_history_arena);
+  return UNITY_END();
+}